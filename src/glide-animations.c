@@ -22,6 +22,9 @@
 
 #include "glide-animations.h"
 #include "glide-slide.h"
+#include "glide-cogl-util.h"
+
+#include "glide-debug.h"
 
 static void
 glide_animations_fade_completed (ClutterTimeline *t, gpointer user_data)
@@ -34,7 +37,7 @@ glide_animations_fade_completed (ClutterTimeline *t, gpointer user_data)
 
 
 ClutterTimeline *
-glide_animations_animate_fade (ClutterActor *a, ClutterActor *b, guint duration)
+glide_animations_animate_fade (ClutterActor *a, ClutterActor *b, guint duration, gulong easing)
 {
   ClutterTimeline *timeline = clutter_timeline_new (duration);
 
@@ -43,7 +46,7 @@ glide_animations_animate_fade (ClutterActor *a, ClutterActor *b, guint duration)
   
   clutter_actor_raise (b, a);
   
-  clutter_actor_animate_with_timeline (b, CLUTTER_LINEAR, timeline, "opacity", 0xff, NULL);
+  clutter_actor_animate_with_timeline (b, easing, timeline, "opacity", 0xff, NULL);
   
   clutter_timeline_start (timeline);
   
@@ -63,7 +66,7 @@ glide_animations_slide_completed (ClutterTimeline *t, gpointer user_data)
 }
 
 ClutterTimeline *
-glide_animations_animate_slide (ClutterActor *a, ClutterActor *b, guint duration)
+glide_animations_animate_slide (ClutterActor *a, ClutterActor *b, guint duration, gulong easing)
 {
   ClutterTimeline *timeline = clutter_timeline_new (duration);
   ClutterActor *stage = clutter_actor_get_stage (a);
@@ -75,9 +78,9 @@ glide_animations_animate_slide (ClutterActor *a, ClutterActor *b, guint duration
   clutter_actor_get_size (stage, &width, &height);
   
   clutter_actor_set_x (b, width);
-  clutter_actor_animate_with_timeline(b, CLUTTER_EASE_IN_OUT_SINE, timeline,
+  clutter_actor_animate_with_timeline(b, easing, timeline,
 				      "x", 0, NULL);
-  clutter_actor_animate_with_timeline(a, CLUTTER_EASE_IN_OUT_SINE, timeline,
+  clutter_actor_animate_with_timeline(a, easing, timeline,
 				      "x", -width, NULL);
   
   
@@ -89,7 +92,7 @@ glide_animations_animate_slide (ClutterActor *a, ClutterActor *b, guint duration
 }
 
 ClutterTimeline *
-glide_animations_animate_pivot (ClutterActor *a, ClutterActor *b, guint duration)
+glide_animations_animate_pivot (ClutterActor *a, ClutterActor *b, guint duration, gulong easing)
 {
   ClutterTimeline *timeline = clutter_timeline_new (duration);
 
@@ -97,7 +100,7 @@ glide_animations_animate_pivot (ClutterActor *a, ClutterActor *b, guint duration
 
   clutter_actor_set_rotation (b, CLUTTER_X_AXIS, 80, 0, 0, 0);
   
-  clutter_actor_animate_with_timeline (b, CLUTTER_EASE_OUT_BOUNCE, timeline, "rotation-angle-x", (gdouble)0, NULL);
+  clutter_actor_animate_with_timeline (b, easing, timeline, "rotation-angle-x", (gdouble)0, NULL);
   
   clutter_timeline_start (timeline);
 
@@ -107,7 +110,7 @@ glide_animations_animate_pivot (ClutterActor *a, ClutterActor *b, guint duration
 }
 
 ClutterTimeline *
-glide_animations_animate_zoom (ClutterActor *a, ClutterActor *b, guint duration)
+glide_animations_animate_zoom (ClutterActor *a, ClutterActor *b, guint duration, gulong easing)
 {
   ClutterTimeline *timeline = clutter_timeline_new (duration);
   ClutterActor *stage = clutter_actor_get_stage (a);
@@ -120,7 +123,7 @@ glide_animations_animate_zoom (ClutterActor *a, ClutterActor *b, guint duration)
   clutter_actor_set_scale_full (b, 0, 0, width/2.0, -height/2.0);
   //  clutter_actor_set_opacity (b, 0x00);
 
-  clutter_actor_animate_with_timeline (b, CLUTTER_EASE_IN_OUT_SINE, timeline, "scale-x", (gdouble)1, "scale-y", (gdouble)1, NULL);
+  clutter_actor_animate_with_timeline (b, easing, timeline, "scale-x", (gdouble)1, "scale-y", (gdouble)1, NULL);
   clutter_actor_animate_with_timeline (a, CLUTTER_EASE_IN_EXPO, timeline, "opacity", 0, NULL);
   
   clutter_timeline_start (timeline);
@@ -131,7 +134,7 @@ glide_animations_animate_zoom (ClutterActor *a, ClutterActor *b, guint duration)
 }
 
 ClutterTimeline *
-glide_animations_animate_drop (ClutterActor *a, ClutterActor *b, guint duration)
+glide_animations_animate_drop (ClutterActor *a, ClutterActor *b, guint duration, gulong easing)
 {
   ClutterTimeline *timeline = clutter_timeline_new (duration);
   ClutterActor *stage = clutter_actor_get_stage (a);
@@ -140,7 +143,7 @@ glide_animations_animate_drop (ClutterActor *a, ClutterActor *b, guint duration)
   clutter_actor_raise (b, a);
 
   clutter_actor_set_y (b, -clutter_actor_get_height (CLUTTER_ACTOR (stage)));
-  clutter_actor_animate_with_timeline (b, CLUTTER_EASE_OUT_BOUNCE, timeline, "y", 0, NULL);  
+  clutter_actor_animate_with_timeline (b, easing, timeline, "y", 0, NULL);  
   
   clutter_timeline_start (timeline);
   
@@ -151,7 +154,7 @@ glide_animations_animate_drop (ClutterActor *a, ClutterActor *b, guint duration)
 
 
 ClutterTimeline *
-glide_animations_animate_zoom_contents (ClutterActor *a, ClutterActor *b, guint duration)
+glide_animations_animate_zoom_contents (ClutterActor *a, ClutterActor *b, guint duration, gulong easing)
 {
 
   ClutterTimeline *timeline = clutter_timeline_new (duration);
@@ -170,10 +173,10 @@ glide_animations_animate_zoom_contents (ClutterActor *a, ClutterActor *b, guint
   
   clutter_actor_set_scale_full (bc, 1.5, 1.5, width/2.0, height/2.0);
   
-  clutter_actor_animate_with_timeline (bc, CLUTTER_EASE_IN_OUT_SINE, timeline, "scale-x", (gdouble)1, "scale-y", (gdouble)1, NULL);
-  clutter_actor_animate_with_timeline (b, CLUTTER_EASE_IN_OUT_SINE, timeline,
+  clutter_actor_animate_with_timeline (bc, easing, timeline, "scale-x", (gdouble)1, "scale-y", (gdouble)1, NULL);
+  clutter_actor_animate_with_timeline (b, easing, timeline,
 				       "opacity", 0xff, NULL);
-  clutter_actor_animate_with_timeline (a, CLUTTER_EASE_IN_OUT_SINE, timeline,
+  clutter_actor_animate_with_timeline (a, easing, timeline,
 				       "opacity", 0x00, NULL);
   
   clutter_timeline_start (timeline);
@@ -184,7 +187,7 @@ glide_animations_animate_zoom_contents (ClutterActor *a, ClutterActor *b, guint
 }
 
 ClutterTimeline *
-glide_animations_animate_pivot_contents (ClutterActor *a, ClutterActor *b, guint duration)
+glide_animations_animate_pivot_contents (ClutterActor *a, ClutterActor *b, guint duration, gulong easing)
 {
   ClutterTimeline *timeline = clutter_timeline_new (duration);
   ClutterActor *stage = clutter_actor_get_stage (a);
@@ -202,10 +205,10 @@ glide_animations_animate_pivot_contents (ClutterActor *a, ClutterActor *b, guint
   
   clutter_actor_set_scale_full (bc, 1.5, 1.5, width/2.0, height/2.0);
   
-  clutter_actor_animate_with_timeline (bc, CLUTTER_EASE_IN_OUT_SINE, timeline, "scale-x", (gdouble)1, "scale-y", (gdouble)1, NULL);
-  clutter_actor_animate_with_timeline (b, CLUTTER_EASE_IN_OUT_SINE, timeline,
+  clutter_actor_animate_with_timeline (bc, easing, timeline, "scale-x", (gdouble)1, "scale-y", (gdouble)1, NULL);
+  clutter_actor_animate_with_timeline (b, easing, timeline,
 				       "opacity", 0xff, NULL);
-  clutter_actor_animate_with_timeline (a, CLUTTER_EASE_IN_OUT_SINE, timeline,
+  clutter_actor_animate_with_timeline (a, easing, timeline,
 				       "opacity", 0x00, NULL);
   
   clutter_timeline_start (timeline);
@@ -215,136 +218,495 @@ glide_animations_animate_pivot_contents (ClutterActor *a, ClutterActor *b, guint
   return timeline;
 }
 
-typedef struct
-_doorway_finished_data_t {
-  ClutterActor *a;
-  ClutterActor *b;
+/*
+ * Jumps a running timeline to its end: animations attached to it get
+ * their final values and completed handlers run, as if it had played
+ * out. glide_animations_timeline_get_finished tells the two apart.
+ */
+void
+glide_animations_timeline_finish (ClutterTimeline *timeline)
+{
+  guint duration = clutter_timeline_get_duration (timeline);
+  
+  if (!clutter_timeline_is_playing (timeline))
+    return;
+  
+  g_object_ref (timeline);
+  g_object_set_data (G_OBJECT (timeline), "glide-animations-finished", GINT_TO_POINTER (TRUE));
+  
+  clutter_timeline_stop (timeline);
+  clutter_timeline_advance (timeline, duration);
+  
+  g_signal_emit_by_name (timeline, "new-frame", duration);
+  g_signal_emit_by_name (timeline, "completed");
+  
+  g_object_unref (timeline);
+}
+
+/* Whether timeline was cut short by glide_animations_timeline_finish */
+gboolean
+glide_animations_timeline_get_finished (ClutterTimeline *timeline)
+{
+  return GPOINTER_TO_INT (g_object_get_data (G_OBJECT (timeline), "glide-animations-finished"));
+}
+
+/*
+ * The Doorway scaffolding is built once and kept on the stage, hidden
+ * between uses. Each run points the clones at the new pair of slides.
+ */
+typedef struct _GlideDoorwayContext {
   ClutterActor *left;
   ClutterActor *right;
   ClutterActor *reflection;
   ClutterActor *group;
-} doorway_finished_data_t;
+
+  ClutterActor *a;
+  ClutterActor *b;
+  
+  ClutterTimeline *timeline;
+} GlideDoorwayContext;
+
+static GlideDoorwayContext doorway = { NULL, };
+
+static void
+glide_animations_doorway_ensure (ClutterActor *stage)
+{
+  if (!doorway.group)
+    {
+      doorway.left = g_object_ref_sink (clutter_clone_new (NULL));
+      doorway.right = g_object_ref_sink (clutter_clone_new (NULL));
+      doorway.reflection = clutter_clone_new (NULL);
+      doorway.group = g_object_ref_sink (clutter_group_new ());
+      
+      clutter_container_add_actor (CLUTTER_CONTAINER (doorway.group), doorway.reflection);
+    }
+  
+  if (clutter_actor_get_parent (doorway.group) != stage)
+    {
+      ClutterActor *actors[] = { doorway.group, doorway.left, doorway.right };
+      guint i;
+      
+      for (i = 0; i < G_N_ELEMENTS (actors); i++)
+	{
+	  if (clutter_actor_get_parent (actors[i]))
+	    clutter_actor_reparent (actors[i], stage);
+	  else
+	    clutter_container_add_actor (CLUTTER_CONTAINER (stage), actors[i]);
+	}
+    }
+}
 
 static void
 glide_animations_doorway_completed (ClutterTimeline *t, gpointer user_data)
 {
   ClutterActor *stage;
-  doorway_finished_data_t *d = (doorway_finished_data_t *)user_data;
 
-  clutter_actor_set_opacity (d->a, 0xff);
-  clutter_actor_hide (d->a);
+  clutter_actor_set_opacity (doorway.a, 0xff);
+  clutter_actor_hide (doorway.a);
   
-  stage = clutter_actor_get_stage (d->a);
+  stage = clutter_actor_get_parent (doorway.group);
     
-  clutter_actor_reparent (d->b, stage);
-
-  clutter_container_remove_actor (CLUTTER_CONTAINER (stage), d->left);
-  clutter_container_remove_actor (CLUTTER_CONTAINER (stage), d->right);
-  clutter_container_remove_actor (CLUTTER_CONTAINER (d->group), d->reflection);
-  clutter_container_remove_actor (CLUTTER_CONTAINER (stage), d->group);
+  clutter_actor_reparent (doorway.b, stage);
   
-  g_free (d);
+  clutter_actor_hide (doorway.left);
+  clutter_actor_hide (doorway.right);
+  clutter_actor_hide (doorway.group);
+  
+  // Don't keep the slides alive through the clones.
+  clutter_clone_set_source (CLUTTER_CLONE (doorway.left), NULL);
+  clutter_clone_set_source (CLUTTER_CLONE (doorway.right), NULL);
+  clutter_clone_set_source (CLUTTER_CLONE (doorway.reflection), NULL);
+  
+  doorway.a = doorway.b = NULL;
+  doorway.timeline = NULL;
 }
 
 ClutterTimeline *
-glide_animations_animate_doorway (ClutterActor *a, ClutterActor *b, guint duration)
+glide_animations_animate_doorway (ClutterActor *a, ClutterActor *b, guint duration, gulong easing)
 {
-  ClutterTimeline *timeline = clutter_timeline_new (duration);
+  ClutterTimeline *timeline;
   ClutterActor *stage = clutter_actor_get_stage (a);
-  ClutterActor *left, *right, *reflection;
   ClutterVertex rotation_center;
   gfloat width, height;
-  ClutterActor *group = clutter_group_new ();
-  doorway_finished_data_t *d = (doorway_finished_data_t *)g_malloc (sizeof (doorway_finished_data_t));
+  
+  // Interrupted, finish the running one instead of stacking on it.
+  if (doorway.timeline)
+    glide_animations_timeline_finish (doorway.timeline);
+  
+  glide_animations_doorway_ensure (stage);
+  
+  timeline = clutter_timeline_new (duration);
   
   clutter_actor_show_all (b);
   clutter_actor_raise (a, b);
   
-  left = clutter_clone_new (a);
-  right = clutter_clone_new (a);
+  clutter_clone_set_source (CLUTTER_CLONE (doorway.left), a);
+  clutter_clone_set_source (CLUTTER_CLONE (doorway.right), a);
+  clutter_clone_set_source (CLUTTER_CLONE (doorway.reflection), b);
   
-  reflection = clutter_clone_new (b);
+  clutter_actor_get_size (stage, &width, &height);
   
   rotation_center.x = width;
   rotation_center.y = 0;
   rotation_center.z = 0;
   
-  g_object_set (reflection, "rotation-center-z", &rotation_center, NULL);
+  g_object_set (doorway.reflection, "rotation-center-z", &rotation_center, NULL);
 
-  g_object_set (reflection, "rotation-angle-z", (gdouble)180, NULL);
-  g_object_set (reflection, "rotation-angle-y", (gdouble)180, NULL);
+  g_object_set (doorway.reflection, "rotation-angle-z", (gdouble)180, NULL);
+  g_object_set (doorway.reflection, "rotation-angle-y", (gdouble)180, NULL);
   
-  clutter_actor_get_size (stage, &width, &height);
-  clutter_actor_set_size (left, width, height);
-  clutter_actor_set_size (right, width, height);
-  clutter_actor_set_size (reflection, width, height);
-
-  clutter_actor_set_opacity (reflection, 80);
-  clutter_actor_set_position (reflection, 0, height*2);
+  clutter_actor_set_size (doorway.left, width, height);
+  clutter_actor_set_size (doorway.right, width, height);
+  clutter_actor_set_size (doorway.reflection, width, height);
 
+  clutter_actor_set_opacity (doorway.reflection, 80);
+  clutter_actor_set_position (doorway.reflection, 0, height*2);
   
-  rotation_center.x = width;
-  rotation_center.y = 0;
-  rotation_center.z = 0;
+  g_object_set (doorway.right, "rotation-center-y", &rotation_center, NULL);
   
-  g_object_set (right, "rotation-center-y", &rotation_center, NULL);
+  clutter_actor_set_clip (doorway.left, 0, 0, width/2.0, height);
+  clutter_actor_set_clip (doorway.right, width/2.0, 0, width, height);
   
-  clutter_actor_set_clip (left, 0, 0, width/2.0, height);
-  clutter_actor_set_clip (right, width/2.0, 0, width, height);
+  // Left over from the last run.
+  clutter_actor_set_opacity (doorway.left, 0xff);
+  clutter_actor_set_opacity (doorway.right, 0xff);
+  clutter_actor_set_rotation (doorway.left, CLUTTER_Y_AXIS, 0, 0, 0, 0);
+  clutter_actor_set_rotation (doorway.right, CLUTTER_Y_AXIS, 0, width, 0, 0);
   
-  clutter_container_add_actor (CLUTTER_CONTAINER (stage), left);
-  clutter_container_add_actor (CLUTTER_CONTAINER (stage), right);  
-  clutter_actor_show (left);
-  clutter_actor_show (right);
+  clutter_actor_show (doorway.left);
+  clutter_actor_show (doorway.right);
 
-  clutter_actor_show (reflection);
+  clutter_actor_show (doorway.reflection);
   
-  clutter_actor_set_position (left, 0, 0);
-  clutter_actor_set_position (right, 0, 0);
+  clutter_actor_set_position (doorway.left, 0, 0);
+  clutter_actor_set_position (doorway.right, 0, 0);
   
   clutter_actor_set_opacity (a, 0x00);
   
-  clutter_container_remove_actor (CLUTTER_CONTAINER (stage), b);
-  clutter_container_add_actor (CLUTTER_CONTAINER (group), b);
-  clutter_container_add_actor (CLUTTER_CONTAINER (group), reflection);
-  clutter_container_add_actor (CLUTTER_CONTAINER (stage), group);
-  
+  clutter_actor_reparent (b, doorway.group);
+  clutter_actor_raise (doorway.reflection, b);
 
-  clutter_actor_set_size (group, width, height);
-  clutter_actor_set_scale_full (group, 0.5, 0.5, width/2.0, height/2.0);
+  clutter_actor_set_size (doorway.group, width, height);
+  clutter_actor_set_scale_full (doorway.group, 0.5, 0.5, width/2.0, height/2.0);
   
-  clutter_actor_show (group);
+  clutter_actor_show (doorway.group);
   
-  clutter_actor_raise (left, group);
-  clutter_actor_raise (right, group);
+  clutter_actor_raise_top (doorway.group);
+  clutter_actor_raise (doorway.left, doorway.group);
+  clutter_actor_raise (doorway.right, doorway.group);
 
-  clutter_actor_animate_with_timeline (left, CLUTTER_EASE_OUT_SINE,
+  clutter_actor_animate_with_timeline (doorway.left, easing,
 				       timeline,
 				       "x", -width/2.0,
 				       "rotation-angle-y", (gdouble)10,
 				       "opacity", 0x00,
 				       NULL);
-  clutter_actor_animate_with_timeline (right, CLUTTER_EASE_OUT_SINE,
+  clutter_actor_animate_with_timeline (doorway.right, easing,
   				       timeline,
   				       "x", width-width/2.0,
 				       "rotation-angle-y", (gdouble)-10,
 				       "opacity", 0x00,
   				       NULL);
-  clutter_actor_animate_with_timeline (group, CLUTTER_EASE_OUT_SINE,
+  clutter_actor_animate_with_timeline (doorway.group, easing,
 				       timeline,
 				       "scale-x", (gdouble)1,
 				       "scale-y", (gdouble)1,
 				       NULL);
   clutter_timeline_start (timeline);
   
+  doorway.a = a;
+  doorway.b = b;
+  doorway.timeline = timeline;
+  
+  g_signal_connect (timeline, "completed", G_CALLBACK (glide_animations_doorway_completed), NULL);
+  
+  return timeline;
+}
+
+typedef struct _GlideOffscreenAnimationData {
+  ClutterActor *a;
+  ClutterActor *b;
+  
+  ClutterActor *quad_a;
+  ClutterActor *quad_b;
+} GlideOffscreenAnimationData;
+
+static ClutterActor *
+glide_animations_snapshot_slide (ClutterActor *slide, gfloat width, gfloat height)
+{
+  ClutterActorBox box;
+  ClutterActor *quad;
+  CoglHandle texture;
+  
+  // Lays out the slide if it was only just shown.
+  clutter_actor_get_allocation_box (slide, &box);
+  
+  texture = glide_cogl_util_render_actor_to_texture (slide, width, height);
+  if (texture == COGL_INVALID_HANDLE)
+    return NULL;
+  
+  quad = clutter_texture_new ();
+  clutter_texture_set_cogl_texture (CLUTTER_TEXTURE (quad), texture);
+  cogl_handle_unref (texture);
+  
+  clutter_actor_set_size (quad, width, height);
+  clutter_actor_set_position (quad, 0, 0);
+  
+  return quad;
+}
+
+static void
+glide_animations_offscreen_completed (ClutterTimeline *t, gpointer user_data)
+{
+  GlideOffscreenAnimationData *d = (GlideOffscreenAnimationData *)user_data;
+  
+  clutter_actor_destroy (d->quad_a);
+  clutter_actor_destroy (d->quad_b);
+  g_object_unref (d->quad_a);
+  g_object_unref (d->quad_b);
+  
+  clutter_actor_show_all (d->b);
+  
+  g_free (d);
+}
+
+/*
+ * Renders both slides once and runs the animation on textured quads in
+ * their place, so a frame of the transition costs two rectangles
+ * however much text the slides hold. Animations which reach into the
+ * slide contents, like Zoom Contents, have to run on the live slides.
+ * Falls back to them as well when offscreen rendering is unavailable.
+ */
+ClutterTimeline *
+glide_animations_animate_offscreen (GlideAnimationFunc func,
+				    ClutterActor *a,
+				    ClutterActor *b,
+				    guint duration,
+				    gulong easing)
+{
+  ClutterActor *stage = clutter_actor_get_stage (a);
+  GlideOffscreenAnimationData *d;
+  ClutterActor *quad_a, *quad_b;
+  ClutterTimeline *timeline;
+  gfloat width, height;
+  
+  clutter_actor_get_size (stage, &width, &height);
+  
+  clutter_actor_show_all (b);
+  
+  quad_a = glide_animations_snapshot_slide (a, width, height);
+  quad_b = quad_a ? glide_animations_snapshot_slide (b, width, height) : NULL;
+  
+  if (!quad_b)
+    {
+      GLIDE_NOTE (PAINT, "Offscreen rendering unavailable, animating live slides");
+      
+      if (quad_a)
+	clutter_actor_destroy (quad_a);
+      
+      return func (a, b, duration, easing);
+    }
+  
+  clutter_container_add (CLUTTER_CONTAINER (stage), quad_a, quad_b, NULL);
+  clutter_actor_show (quad_a);
+  clutter_actor_hide (quad_b);
+  
+  clutter_actor_hide (a);
+  clutter_actor_hide (b);
+  
+  d = g_malloc (sizeof (GlideOffscreenAnimationData));
   d->a = a;
   d->b = b;
-  d->left = left;
-  d->right = right;
-  d->reflection = reflection;
-  d->group = group;
+  // Animations like Doorway take the actors off the stage for a while.
+  d->quad_a = g_object_ref (quad_a);
+  d->quad_b = g_object_ref (quad_b);
+  
+  timeline = func (quad_a, quad_b, duration, easing);
+  
+  // After the animation's own handler, which resets the quads.
+  g_signal_connect (timeline, "completed", G_CALLBACK (glide_animations_offscreen_completed), d);
+  
+  return timeline;
+}
+
+static GPtrArray *animations = NULL;
+
+GlideAnimationInfo *
+glide_animations_register (const gchar *name,
+			   GlideAnimationFunc func,
+			   guint duration,
+			   gulong easing,
+			   gboolean offscreen)
+{
+  GlideAnimationInfo *info = g_new0 (GlideAnimationInfo, 1);
+  
+  info->name = g_intern_string (name);
+  info->quark = g_quark_from_static_string (info->name);
+  info->func = func;
+  info->duration = duration;
+  info->easing = easing;
+  info->offscreen = offscreen;
+  
+  if (!animations)
+    animations = g_ptr_array_new ();
+  g_ptr_array_add (animations, info);
+  
+  return info;
+}
+
+static void
+glide_animations_ensure_registry (void)
+{
+  if (animations)
+    return;
+  
+  glide_animations_register ("Fade", glide_animations_animate_fade, 1000, CLUTTER_LINEAR, TRUE);
+  glide_animations_register ("Zoom", glide_animations_animate_zoom, 1200, CLUTTER_EASE_IN_OUT_SINE, TRUE);
+  glide_animations_register ("Drop", glide_animations_animate_drop, 1500, CLUTTER_EASE_OUT_BOUNCE, TRUE);
+  glide_animations_register ("Pivot", glide_animations_animate_pivot, 2000, CLUTTER_EASE_OUT_BOUNCE, TRUE);
+  glide_animations_register ("Slide", glide_animations_animate_slide, 1200, CLUTTER_EASE_IN_OUT_SINE, TRUE);
+  // Animates the slide contents, so it needs the live actors.
+  glide_animations_register ("Zoom Contents", glide_animations_animate_zoom_contents, 1200, CLUTTER_EASE_IN_OUT_SINE, FALSE);
+  glide_animations_register ("Doorway", glide_animations_animate_doorway, 1200, CLUTTER_EASE_OUT_SINE, TRUE);
+}
+
+/* Returns NULL for "None" or an unknown name */
+GlideAnimationInfo *
+glide_animations_lookup (const gchar *name)
+{
+  GQuark quark;
+  guint i;
+  
+  glide_animations_ensure_registry ();
+  
+  if (!name || !(quark = g_quark_try_string (name)))
+    return NULL;
+  
+  for (i = 0; i < animations->len; i++)
+    {
+      GlideAnimationInfo *info = g_ptr_array_index (animations, i);
+      if (info->quark == quark)
+	return info;
+    }
+  return NULL;
+}
+
+/* In registration order, free the list but not its contents */
+GList *
+glide_animations_list (void)
+{
+  GList *list = NULL;
+  gint i;
+  
+  glide_animations_ensure_registry ();
+  
+  for (i = animations->len - 1; i >= 0; i--)
+    list = g_list_prepend (list, g_ptr_array_index (animations, i));
+  
+  return list;
+}
+
+typedef struct _GlideAnimationRun {
+  GlideAnimationInfo *info;
+  
+  GTimer *timer;
+  gdouble last_frame;
+  guint frames;
+  
+  /* Milliseconds between consecutive frames */
+  GArray *frame_times;
+} GlideAnimationRun;
+
+static GlideAnimationRunNotify run_notify = NULL;
+static gpointer run_notify_data = NULL;
+
+/* notify is called with the frame times of every run played out */
+void
+glide_animations_set_run_notify (GlideAnimationRunNotify notify, gpointer user_data)
+{
+  run_notify = notify;
+  run_notify_data = user_data;
+}
+
+static void
+glide_animations_run_new_frame (ClutterTimeline *timeline,
+				gint msecs,
+				gpointer user_data)
+{
+  GlideAnimationRun *run = (GlideAnimationRun *)user_data;
+  gdouble now = g_timer_elapsed (run->timer, NULL);
+  
+  // The last frame of a run cut short is made up.
+  if (glide_animations_timeline_get_finished (timeline))
+    return;
+  
+  if (run->frames)
+    {
+      gdouble delta = (now - run->last_frame) * 1000.0;
+      
+      g_array_append_val (run->frame_times, delta);
+      if (now - run->last_frame > run->info->longest_frame)
+	run->info->longest_frame = now - run->last_frame;
+    }
+  
+  run->last_frame = now;
+  run->frames++;
+}
+
+static void
+glide_animations_run_completed (ClutterTimeline *timeline,
+				gpointer user_data)
+{
+  GlideAnimationRun *run = (GlideAnimationRun *)user_data;
+  GlideAnimationInfo *info = run->info;
+  gdouble elapsed = g_timer_elapsed (run->timer, NULL);
+  
+  g_signal_handlers_disconnect_by_func (timeline, glide_animations_run_new_frame, run);
+  g_signal_handlers_disconnect_by_func (timeline, glide_animations_run_completed, run);
+  
+  // Interrupted runs say nothing about how fast the animation plays.
+  if (glide_animations_timeline_get_finished (timeline))
+    {
+      GLIDE_NOTE (PAINT, "Transition %s finished early, not counted", info->name);
+    }
+  else
+    {
+      info->runs++;
+      info->frames += run->frames;
+      info->seconds += elapsed;
+      
+      GLIDE_NOTE (PAINT, "Transition %s: %u frames in %f seconds (%f fps), "
+		  "%f fps over %u runs, longest frame %f seconds",
+		  info->name, run->frames, elapsed, run->frames / elapsed,
+		  info->frames / info->seconds, info->runs, info->longest_frame);
+      
+      if (run_notify)
+	run_notify (info, timeline, run->frame_times, elapsed * 1000.0, run_notify_data);
+    }
+  
+  g_array_free (run->frame_times, TRUE);
+  g_timer_destroy (run->timer);
+  g_free (run);
+}
+
+ClutterTimeline *
+glide_animations_run (GlideAnimationInfo *info, ClutterActor *a, ClutterActor *b)
+{
+  GlideAnimationRun *run;
+  ClutterTimeline *timeline;
+  
+  if (info->offscreen)
+    timeline = glide_animations_animate_offscreen (info->func, a, b, info->duration, info->easing);
+  else
+    timeline = info->func (a, b, info->duration, info->easing);
+  
+  run = g_new0 (GlideAnimationRun, 1);
+  run->info = info;
+  run->timer = g_timer_new ();
+  run->frame_times = g_array_new (FALSE, FALSE, sizeof (gdouble));
   
-  g_signal_connect (timeline, "completed", G_CALLBACK (glide_animations_doorway_completed), d);
+  g_signal_connect (timeline, "new-frame", G_CALLBACK (glide_animations_run_new_frame), run);
+  g_signal_connect (timeline, "completed", G_CALLBACK (glide_animations_run_completed), run);
   
   return timeline;
 }
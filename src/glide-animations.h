@@ -25,12 +25,51 @@
 
 #include <clutter/clutter.h>
 
-ClutterTimeline *glide_animations_animate_fade (ClutterActor *a, ClutterActor *b, guint duration);
-ClutterTimeline *glide_animations_animate_drop (ClutterActor *a, ClutterActor *b, guint duration);
-ClutterTimeline *glide_animations_animate_zoom (ClutterActor *a, ClutterActor *b, guint duration);
-ClutterTimeline *glide_animations_animate_zoom_contents (ClutterActor *a, ClutterActor *b, guint duration);
-ClutterTimeline *glide_animations_animate_pivot (ClutterActor *a, ClutterActor *b, guint duration);
-ClutterTimeline *glide_animations_animate_slide (ClutterActor *a, ClutterActor *b, guint duration);
-ClutterTimeline *glide_animations_animate_doorway (ClutterActor *a, ClutterActor *b, guint duration);
+typedef ClutterTimeline *(*GlideAnimationFunc) (ClutterActor *a, ClutterActor *b, guint duration, gulong easing);
+
+typedef struct _GlideAnimationInfo GlideAnimationInfo;
+
+struct _GlideAnimationInfo {
+  const gchar *name;
+  GQuark quark;
+  
+  GlideAnimationFunc func;
+  guint duration;
+  gulong easing;
+  
+  /* Whether the animation can run on snapshots of the slides */
+  gboolean offscreen;
+  
+  /* Frame statistics over every run so far */
+  guint runs;
+  guint frames;
+  gdouble seconds;
+  gdouble longest_frame;
+};
+
+ClutterTimeline *glide_animations_animate_fade (ClutterActor *a, ClutterActor *b, guint duration, gulong easing);
+ClutterTimeline *glide_animations_animate_drop (ClutterActor *a, ClutterActor *b, guint duration, gulong easing);
+ClutterTimeline *glide_animations_animate_zoom (ClutterActor *a, ClutterActor *b, guint duration, gulong easing);
+ClutterTimeline *glide_animations_animate_zoom_contents (ClutterActor *a, ClutterActor *b, guint duration, gulong easing);
+ClutterTimeline *glide_animations_animate_pivot (ClutterActor *a, ClutterActor *b, guint duration, gulong easing);
+ClutterTimeline *glide_animations_animate_slide (ClutterActor *a, ClutterActor *b, guint duration, gulong easing);
+ClutterTimeline *glide_animations_animate_doorway (ClutterActor *a, ClutterActor *b, guint duration, gulong easing);
+
+void glide_animations_timeline_finish (ClutterTimeline *timeline);
+gboolean glide_animations_timeline_get_finished (ClutterTimeline *timeline);
+
+ClutterTimeline *glide_animations_animate_offscreen (GlideAnimationFunc func, ClutterActor *a, ClutterActor *b, guint duration, gulong easing);
+
+GlideAnimationInfo *glide_animations_register (const gchar *name, GlideAnimationFunc func, 
+					       guint duration, gulong easing, gboolean offscreen);
+GlideAnimationInfo *glide_animations_lookup (const gchar *name);
+GList *glide_animations_list (void);
+
+ClutterTimeline *glide_animations_run (GlideAnimationInfo *info, ClutterActor *a, ClutterActor *b);
+
+/* frame_times holds the milliseconds between frames, duration is in milliseconds */
+typedef void (*GlideAnimationRunNotify) (GlideAnimationInfo *info, ClutterTimeline *timeline,
+					 GArray *frame_times, gdouble duration, gpointer user_data);
+void glide_animations_set_run_notify (GlideAnimationRunNotify notify, gpointer user_data);
 
 #endif
@@ -0,0 +1,243 @@
+/*
+ * glide-batch.c
+ * This file is part of glide
+ *
+ * Copyright (C) 2010 - Robert Carr
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, 
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <clutter/clutter.h>
+
+#include "glide-batch.h"
+
+#include "glide-document.h"
+#include "glide-stage-manager.h"
+#include "glide-export.h"
+
+#include "glide-debug.h"
+
+/*
+ * Runs jobs over documents given on the command line without any of
+ * the GTK user interface. Documents are loaded by a stage manager on
+ * a stage which is never shown, and only realized for jobs which may
+ * need GL.
+ */
+
+static gboolean batch_enabled = FALSE;
+
+static gboolean batch_validate = FALSE;
+static gboolean batch_resave = FALSE;
+/* Set from --compact-json, which the window uses too */
+static gboolean batch_pretty = TRUE;
+static gchar *batch_output_dir = NULL;
+static gboolean batch_export_pdf = FALSE;
+static gboolean batch_export_vector = TRUE;
+
+static gchar *export_images_dir = NULL;
+static gchar *export_size = NULL;
+static gchar *export_format = NULL;
+static gint export_jobs = 0;
+static gboolean export_reuse = FALSE;
+
+static GOptionEntry glide_batch_args[] = {
+  {"batch", 0, 0, G_OPTION_ARG_NONE, &batch_enabled,
+   "Process the documents given without opening a window", NULL},
+  {"validate", 0, 0, G_OPTION_ARG_NONE, &batch_validate,
+   "Check that each document loads, the default in batch mode", NULL},
+  {"resave", 0, 0, G_OPTION_ARG_NONE, &batch_resave,
+   "Write each document back in the current format", NULL},
+  {"export-pdf", 0, 0, G_OPTION_ARG_NONE, &batch_export_pdf,
+   "Export each document as a PDF next to it, or in the output directory", NULL},
+  {"raster", 0, G_OPTION_FLAG_REVERSE, G_OPTION_ARG_NONE, &batch_export_vector,
+   "Rasterize every page of exported PDFs", NULL},
+  {"output-dir", 0, 0, G_OPTION_ARG_FILENAME, &batch_output_dir,
+   "Directory to write exported PDFs to", "DIR"},
+  {"export-images", 0, 0, G_OPTION_ARG_FILENAME, &export_images_dir,
+   "Render every slide to an image in DIR, in a subdirectory per document when given several. Implies --batch",
+   "DIR"},
+  {"size", 0, 0, G_OPTION_ARG_STRING, &export_size,
+   "Size of exported images, defaults to the size of the document", "WxH"},
+  {"format", 0, 0, G_OPTION_ARG_STRING, &export_format,
+   "Format of exported images, png (the default) or jpeg", "FORMAT"},
+  {"jobs", 0, 0, G_OPTION_ARG_INT, &export_jobs,
+   "Number of threads encoding exported images, defaults to the number of processors", "N"},
+  {"reuse", 0, 0, G_OPTION_ARG_NONE, &export_reuse,
+   "Keep the images of slides which haven't changed since the last export to DIR", NULL},
+  {NULL,},
+};
+
+GOptionGroup *
+glide_batch_get_option_group (void)
+{
+  GOptionGroup *group;
+  
+  group = g_option_group_new ("batch", "Batch Options",
+			      "Show batch mode options", NULL, NULL);
+  g_option_group_add_entries (group, glide_batch_args);
+  
+  return group;
+}
+
+gboolean
+glide_batch_get_enabled (void)
+{
+  return batch_enabled || export_images_dir != NULL;
+}
+
+static gchar *
+glide_batch_output_path (const gchar *filename, const gchar *directory, const gchar *extension)
+{
+  gchar *base = g_path_get_basename (filename);
+  gchar *dir = directory ? g_strdup (directory) : g_path_get_dirname (filename);
+  gchar *dot = strrchr (base, '.');
+  gchar *name, *path;
+  
+  if (dot && dot != base)
+    *dot = '\0';
+  name = extension ? g_strconcat (base, extension, NULL) : g_strdup (base);
+  path = g_build_filename (dir, name, NULL);
+  
+  g_free (base);
+  g_free (dir);
+  g_free (name);
+  
+  return path;
+}
+
+static gboolean
+glide_batch_process (ClutterActor *stage,
+		     const gchar *filename,
+		     gboolean several,
+		     gint width,
+		     gint height,
+		     GlideExportFormat format,
+		     GError **error)
+{
+  GlideDocument *document = glide_document_new (NULL);
+  GlideStageManager *manager;
+  gboolean ret;
+  
+  manager = glide_stage_manager_new (document, CLUTTER_STAGE (stage));
+  
+  ret = glide_stage_manager_load_file (manager, filename, error);
+  
+  if (ret && batch_resave)
+    ret = glide_document_write_to_file (document, filename, batch_pretty, error);
+  
+  if (ret && batch_export_pdf)
+    {
+      gchar *path = glide_batch_output_path (filename, batch_output_dir, ".pdf");
+      
+      if (batch_export_vector)
+	ret = glide_export_pdf_vector (document, path, error);
+      else
+	ret = glide_export_pdf (document, path, 0, 0, error);
+      g_free (path);
+    }
+  
+  if (ret && export_images_dir)
+    {
+      gchar *dir = several ? glide_batch_output_path (filename, export_images_dir, NULL)
+	: g_strdup (export_images_dir);
+      
+      ret = glide_export_images (document, dir, width, height,
+				 format, export_jobs, export_reuse, error);
+      g_free (dir);
+    }
+  
+  g_object_unref (manager);
+  g_object_unref (document);
+  
+  // The stage holds the slides of the document until they are removed.
+  clutter_group_remove_all (CLUTTER_GROUP (stage));
+  
+  return ret;
+}
+
+/*
+ * Returns the exit status, 1 if any document failed. pretty is for
+ * resaved documents, as with --compact-json.
+ */
+int
+glide_batch_run (int argc, char **argv, gboolean pretty)
+{
+  ClutterActor *stage;
+  GlideExportFormat format = GLIDE_EXPORT_FORMAT_PNG;
+  gint width = 0, height = 0;
+  guint n_failed = 0;
+  GTimer *timer;
+  int i;
+  
+  batch_pretty = pretty;
+  
+  if (argc < 2)
+    {
+      g_printerr ("No documents given\n");
+      return 1;
+    }
+  
+  if (export_size && (sscanf (export_size, "%dx%d", &width, &height) != 2 ||
+		      width <= 0 || height <= 0))
+    {
+      g_printerr ("Invalid size '%s', expected WxH\n", export_size);
+      return 1;
+    }
+  
+  if (export_format && (!strcmp (export_format, "jpeg") || !strcmp (export_format, "jpg")))
+    format = GLIDE_EXPORT_FORMAT_JPEG;
+  else if (export_format && strcmp (export_format, "png"))
+    {
+      g_printerr ("Unknown image format '%s'\n", export_format);
+      return 1;
+    }
+  
+  if (export_jobs <= 0)
+    export_jobs = MAX (sysconf (_SC_NPROCESSORS_ONLN), 1);
+  
+  stage = clutter_stage_get_default ();
+  if (batch_export_pdf || export_images_dir)
+    clutter_actor_realize (stage);
+  
+  timer = g_timer_new ();
+  
+  for (i = 1; i < argc; i++)
+    {
+      GError *e = NULL;
+      
+      if (!glide_batch_process (stage, argv[i], argc > 2, width, height, format, &e))
+	{
+	  g_printerr ("%s: %s\n", argv[i], e ? e->message : "Failed");
+	  if (e)
+	    g_error_free (e);
+	  n_failed++;
+	}
+      else if (batch_validate || !(batch_resave || batch_export_pdf || export_images_dir))
+	{
+	  g_print ("%s: OK\n", argv[i]);
+	}
+    }
+  
+  GLIDE_NOTE (MISC, "Processed %d documents (%u failed) in %f seconds",
+	      argc - 1, n_failed, g_timer_elapsed (timer, NULL));
+  g_timer_destroy (timer);
+  
+  return n_failed ? 1 : 0;
+}
@@ -0,0 +1,441 @@
+/*
+ * glide-bench.c
+ * This file is part of glide
+ *
+ * Copyright (C) 2010 - Robert Carr
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+#include <glib/gstdio.h>
+#include <clutter/clutter.h>
+#include <json-glib/json-glib.h>
+
+#include "glide-document.h"
+#include "glide-stage-manager.h"
+#include "glide-slide.h"
+#include "glide-export.h"
+
+#include "glide-debug.h"
+
+/*
+ * Micro-benchmarks over synthetic decks. Each case runs against a deck
+ * of --slides slides holding --actors text boxes each, written to a
+ * temporary file unless one is given with --deck, and reports the time
+ * of every run and the peak resident set size of the process. Run one
+ * case per process when comparing memory, the peak is never reset.
+ * --glide-debug turns on the same timing notes as in glide, say
+ * --glide-debug=stage-manager,document for loading and saving.
+ *
+ *   glide-bench --case load --slides 5000
+ *   glide-bench --case load-tree --slides 5000
+ *   glide-bench --case pdf --slides 300
+ *   glide-bench --case json --slides 2500 --actors 4
+ */
+
+static gint bench_slides = 0;
+static gint bench_actors = 4;
+static gint bench_runs = 3;
+static gboolean bench_eager = FALSE;
+static gchar *bench_deck = NULL;
+static gchar *bench_case = NULL;
+
+/*
+ * Writes the JSON by hand, which adds far less to the peak than building
+ * a deck. Legacy decks store every number as a string, as version 1 did.
+ */
+static GString *
+glide_bench_deck_json (gint n_slides, gint n_actors, gboolean legacy)
+{
+  GString *json = g_string_new (NULL);
+  gint i, j;
+
+  g_string_printf (json, "{\"version\":%d,\"name\":\"Benchmark\",\"slides\":[", legacy ? 1 : 2);
+  for (i = 0; i < n_slides; i++)
+    {
+      g_string_append (json, i ? ",{\"actors\":[" : "{\"actors\":[");
+      for (j = 0; j < n_actors; j++)
+	{
+	  g_string_append (json, j ? ",{\"type\":\"text\",\"geometry\":" : "{\"type\":\"text\",\"geometry\":");
+	  if (legacy)
+	    g_string_append_printf (json, "{\"x\":\"%d\",\"y\":\"%d\",\"width\":\"600.5\",\"height\":\"%d\"}",
+				    50, 50 + 80 * j, 60);
+	  else
+	    g_string_append_printf (json, "[%d,%d,600.5,%d]", 50, 50 + 80 * j, 60);
+	  g_string_append_printf (json,
+				  ",\"text-properties\":{\"text\":\"Slide %d, point %d of the benchmark deck\","
+				  "\"font-name\":\"Sans 24\",\"color\":\"#000000ff\",\"alignment\":\"Left\"}}",
+				  i + 1, j + 1);
+	}
+      g_string_append (json, "],\"animation\":\"Fade\"}");
+    }
+  g_string_append (json, "]}");
+
+  return json;
+}
+
+static gchar *
+glide_bench_generate_deck (gint n_slides, gint n_actors, GError **error)
+{
+  GString *json = glide_bench_deck_json (n_slides, n_actors, FALSE);
+  gchar *path;
+  gboolean ret;
+  gint fd;
+
+  fd = g_file_open_tmp ("glide-bench-XXXXXX.glide", &path, error);
+  if (fd < 0)
+    {
+      g_string_free (json, TRUE);
+      return NULL;
+    }
+  close (fd);
+
+  ret = g_file_set_contents (path, json->str, json->len, error);
+  g_string_free (json, TRUE);
+
+  if (!ret)
+    {
+      g_unlink (path);
+      g_free (path);
+      return NULL;
+    }
+  return path;
+}
+
+typedef gboolean (*GlideBenchFunc) (ClutterActor *stage, const gchar *deck, GError **error);
+
+typedef struct _GlideBenchCase {
+  const gchar *name;
+  GlideBenchFunc func;
+  gint slides;
+  const gchar *description;
+} GlideBenchCase;
+
+static gboolean
+glide_bench_load (ClutterActor *stage, const gchar *deck, GError **error)
+{
+  GlideDocument *document = glide_document_new (NULL);
+  GlideStageManager *manager = glide_stage_manager_new (document, CLUTTER_STAGE (stage));
+  gboolean ret;
+
+  glide_stage_manager_set_lazy_load (manager, !bench_eager);
+  ret = glide_stage_manager_load_file (manager, deck, error);
+
+  g_object_unref (manager);
+  g_object_unref (document);
+  clutter_group_remove_all (CLUTTER_GROUP (stage));
+
+  return ret;
+}
+
+/* The whole tree at once, as the loader did before it streamed the slides */
+static gboolean
+glide_bench_load_tree (ClutterActor *stage, const gchar *deck, GError **error)
+{
+  GlideDocument *document = glide_document_new (NULL);
+  GlideStageManager *manager = glide_stage_manager_new (document, CLUTTER_STAGE (stage));
+  JsonParser *p = json_parser_new ();
+  gboolean ret;
+
+  glide_stage_manager_set_lazy_load (manager, !bench_eager);
+  ret = json_parser_load_from_file (p, deck, error);
+  if (ret)
+    {
+      JsonObject *root = json_node_get_object (json_parser_get_root (p));
+
+      glide_stage_manager_load_slides (manager, json_object_get_array_member (root, "slides"));
+    }
+
+  g_object_unref (p);
+  g_object_unref (manager);
+  g_object_unref (document);
+  clutter_group_remove_all (CLUTTER_GROUP (stage));
+
+  return ret;
+}
+
+static gboolean
+glide_bench_export (GlideDocument *document, const gchar *name, gboolean vector, GError **error)
+{
+  GTimer *timer = g_timer_new ();
+  struct stat buf;
+  gchar *path;
+  gboolean ret;
+  gint fd;
+
+  fd = g_file_open_tmp ("glide-bench-XXXXXX.pdf", &path, error);
+  if (fd < 0)
+    {
+      g_timer_destroy (timer);
+      return FALSE;
+    }
+  close (fd);
+
+  if (vector)
+    ret = glide_export_pdf_vector (document, path, error);
+  else
+    ret = glide_export_pdf (document, path, 0, 0, error);
+
+  if (ret && g_stat (path, &buf) == 0)
+    g_print ("  %s: %.3f ms, %ld KiB\n", name,
+	     g_timer_elapsed (timer, NULL) * 1000.0, (glong) (buf.st_size / 1024));
+
+  g_unlink (path);
+  g_free (path);
+  g_timer_destroy (timer);
+
+  return ret;
+}
+
+/* Both PDF exports of the same deck, with the time and size of each */
+static gboolean
+glide_bench_pdf (ClutterActor *stage, const gchar *deck, GError **error)
+{
+  GlideDocument *document = glide_document_new (NULL);
+  GlideStageManager *manager = glide_stage_manager_new (document, CLUTTER_STAGE (stage));
+  gboolean ret;
+
+  glide_stage_manager_set_lazy_load (manager, !bench_eager);
+  ret = glide_stage_manager_load_file (manager, deck, error) &&
+    glide_bench_export (document, "vector", TRUE, error) &&
+    glide_bench_export (document, "raster", FALSE, error);
+
+  g_object_unref (manager);
+  g_object_unref (document);
+  clutter_group_remove_all (CLUTTER_GROUP (stage));
+
+  return ret;
+}
+
+/* Parses data and builds every slide of it into a new document */
+static gboolean
+glide_bench_deserialize (ClutterActor *stage, const gchar *name, const gchar *data,
+			 gsize length, GError **error)
+{
+  GlideDocument *document = glide_document_new (NULL);
+  GlideStageManager *manager = glide_stage_manager_new (document, CLUTTER_STAGE (stage));
+  JsonParser *p = json_parser_new ();
+  GTimer *timer = g_timer_new ();
+  gboolean ret;
+
+  glide_stage_manager_set_lazy_load (manager, FALSE);
+  ret = json_parser_load_from_data (p, data, length, error);
+  if (ret)
+    {
+      JsonObject *root = json_node_get_object (json_parser_get_root (p));
+
+      glide_stage_manager_load_slides (manager, json_object_get_array_member (root, "slides"));
+      g_print ("  %s: %.3f ms\n", name, g_timer_elapsed (timer, NULL) * 1000.0);
+    }
+
+  g_timer_destroy (timer);
+  g_object_unref (p);
+  g_object_unref (manager);
+  g_object_unref (document);
+  clutter_group_remove_all (CLUTTER_GROUP (stage));
+
+  return ret;
+}
+
+/*
+ * Serializes every actor of the deck and reads the result back, then
+ * reads the same deck with every number stored as a string.
+ */
+static gboolean
+glide_bench_json (ClutterActor *stage, const gchar *deck, GError **error)
+{
+  GlideDocument *document = glide_document_new (NULL);
+  GlideStageManager *manager = glide_stage_manager_new (document, CLUTTER_STAGE (stage));
+  JsonGenerator *gen = json_generator_new ();
+  GTimer *timer = g_timer_new ();
+  JsonNode *node;
+  GString *legacy;
+  gchar *data;
+  gsize length;
+  gboolean ret;
+
+  glide_stage_manager_set_lazy_load (manager, FALSE);
+  if (!glide_stage_manager_load_file (manager, deck, error))
+    {
+      g_timer_destroy (timer);
+      g_object_unref (gen);
+      g_object_unref (manager);
+      g_object_unref (document);
+      clutter_group_remove_all (CLUTTER_GROUP (stage));
+      return FALSE;
+    }
+
+  g_timer_start (timer);
+  node = glide_document_serialize (document);
+  json_generator_set_root (gen, node);
+  data = json_generator_to_data (gen, &length);
+  g_print ("  serialize: %.3f ms, %lu KiB\n", g_timer_elapsed (timer, NULL) * 1000.0,
+	   (gulong) (length / 1024));
+
+  json_node_free (node);
+  g_timer_destroy (timer);
+  g_object_unref (gen);
+  g_object_unref (manager);
+  g_object_unref (document);
+  clutter_group_remove_all (CLUTTER_GROUP (stage));
+
+  ret = glide_bench_deserialize (stage, "deserialize", data, length, error);
+  g_free (data);
+
+  if (ret)
+    {
+      gint n_slides = bench_slides > 0 ? bench_slides : 2500;
+
+      legacy = glide_bench_deck_json (n_slides, bench_actors, TRUE);
+      ret = glide_bench_deserialize (stage, "deserialize legacy", legacy->str, legacy->len, error);
+      g_string_free (legacy, TRUE);
+    }
+
+  return ret;
+}
+
+static const GlideBenchCase glide_bench_cases[] = {
+  {"load", glide_bench_load, 5000, "Load the deck with a stage manager"},
+  {"load-tree", glide_bench_load_tree, 5000, "Parse the whole deck, then load its slides"},
+  {"pdf", glide_bench_pdf, 300, "Export the deck to PDF as vectors and as rasters"},
+  {"json", glide_bench_json, 2500, "Serialize and deserialize the actors of the deck"},
+};
+
+static gboolean
+glide_bench_list_cb (const gchar *option_name, const gchar *value,
+		     gpointer data, GError **error)
+{
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (glide_bench_cases); i++)
+    g_print ("%-12s %s\n", glide_bench_cases[i].name, glide_bench_cases[i].description);
+
+  exit (0);
+}
+
+static GOptionEntry glide_bench_args[] = {
+  {"case", 0, 0, G_OPTION_ARG_STRING, &bench_case,
+   "Benchmark to run, see --list. Defaults to load", "NAME"},
+  {"list", 0, G_OPTION_FLAG_NO_ARG, G_OPTION_ARG_CALLBACK, glide_bench_list_cb,
+   "List the benchmarks", NULL},
+  {"slides", 0, 0, G_OPTION_ARG_INT, &bench_slides,
+   "Slides in the generated deck, the default depends on the benchmark", "N"},
+  {"actors", 0, 0, G_OPTION_ARG_INT, &bench_actors,
+   "Text boxes on each generated slide, 4 by default", "N"},
+  {"runs", 0, 0, G_OPTION_ARG_INT, &bench_runs,
+   "Times to run the benchmark, 3 by default", "N"},
+  {"eager", 0, 0, G_OPTION_ARG_NONE, &bench_eager,
+   "Build every slide as it is loaded rather than when first shown", NULL},
+  {"deck", 0, 0, G_OPTION_ARG_FILENAME, &bench_deck,
+   "Use an existing document instead of generating one", "FILE"},
+  {NULL,},
+};
+
+static glong
+glide_bench_get_peak_rss (void)
+{
+  struct rusage usage;
+
+  if (getrusage (RUSAGE_SELF, &usage) != 0)
+    return 0;
+
+  // Kilobytes on Linux.
+  return usage.ru_maxrss;
+}
+
+int
+main (int argc, char **argv)
+{
+  const GlideBenchCase *bench = NULL;
+  GOptionContext *context;
+  ClutterActor *stage;
+  GError *e = NULL;
+  gchar *deck;
+  gdouble total = 0, best = G_MAXDOUBLE;
+  guint i;
+  gint run;
+
+  g_thread_init (NULL);
+
+  context = g_option_context_new ("- time Glide on synthetic decks");
+  g_option_context_add_main_entries (context, glide_bench_args, NULL);
+  g_option_context_add_group (context, glide_debug_get_option_group ());
+  g_option_context_add_group (context, clutter_get_option_group ());
+  if (!g_option_context_parse (context, &argc, &argv, &e))
+    {
+      g_printerr ("%s\n", e->message);
+      return 1;
+    }
+  g_option_context_free (context);
+
+  for (i = 0; i < G_N_ELEMENTS (glide_bench_cases); i++)
+    if (!g_strcmp0 (bench_case ? bench_case : "load", glide_bench_cases[i].name))
+      bench = &glide_bench_cases[i];
+  if (!bench)
+    {
+      g_printerr ("Unknown benchmark '%s', see --list\n", bench_case);
+      return 1;
+    }
+
+  if (bench_deck)
+    deck = g_strdup (bench_deck);
+  else if (!(deck = glide_bench_generate_deck (bench_slides > 0 ? bench_slides : bench->slides,
+						 bench_actors, &e)))
+    {
+      g_printerr ("Failed to write the deck: %s\n", e->message);
+      return 1;
+    }
+
+  stage = clutter_stage_get_default ();
+
+  g_print ("%s: %s, %s\n", bench->name, deck, bench_eager ? "eager" : "lazy");
+
+  for (run = 0; run < bench_runs; run++)
+    {
+      GTimer *timer = g_timer_new ();
+      gdouble elapsed;
+
+      if (!bench->func (stage, deck, &e))
+	{
+	  g_printerr ("Run %d failed: %s\n", run + 1, e ? e->message : "unknown error");
+	  break;
+	}
+      elapsed = g_timer_elapsed (timer, NULL);
+      g_timer_destroy (timer);
+
+      g_print ("run %d: %.3f ms\n", run + 1, elapsed * 1000.0);
+      total += elapsed;
+      best = MIN (best, elapsed);
+    }
+
+  if (run)
+    g_print ("best %.3f ms, mean %.3f ms, peak RSS %ld KiB\n",
+	     best * 1000.0, total / run * 1000.0, glide_bench_get_peak_rss ());
+
+  if (!bench_deck)
+    g_unlink (deck);
+  g_free (deck);
+
+  return run == bench_runs ? 0 : 1;
+}
@@ -0,0 +1,365 @@
+/*
+ * glide-cairo-util.c
+ * This file is part of glide
+ *
+ * Copyright (C) 2010 - Robert Carr
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, 
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <string.h>
+#include <math.h>
+
+#include <gdk/gdk.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <pango/pangocairo.h>
+
+#include "glide-cairo-util.h"
+
+#include "glide-actor.h"
+#include "glide-image.h"
+#include "glide-text.h"
+
+#include "glide-json-util.h"
+
+#include "glide-debug.h"
+
+/*
+ * Paints filename stretched over width by height. Raster targets,
+ * like thumbnails, only decode the image at the size it is drawn.
+ * Otherwise JPEG files keep their compressed data attached, so
+ * backends which understand it, like PDF, embed the original file
+ * instead of a raster.
+ */
+static void
+glide_cairo_util_draw_image_file (cairo_t *cr,
+				  const gchar *filename,
+				  gdouble width,
+				  gdouble height,
+				  gdouble alpha)
+{
+  GdkPixbufFormat *format;
+  GdkPixbuf *pixbuf;
+  GError *e = NULL;
+  gchar *mime_type = NULL;
+  gint i_width, i_height;
+  gboolean raster;
+  
+  format = gdk_pixbuf_get_file_info (filename, &i_width, &i_height);
+  raster = cairo_surface_get_type (cairo_get_target (cr)) == CAIRO_SURFACE_TYPE_IMAGE;
+  
+  if (format && raster)
+    {
+      gdouble d_width = width, d_height = height;
+      
+      cairo_user_to_device_distance (cr, &d_width, &d_height);
+      d_width = MAX (ceil (fabs (d_width)), 1);
+      d_height = MAX (ceil (fabs (d_height)), 1);
+      
+      if (d_width < i_width || d_height < i_height)
+	pixbuf = gdk_pixbuf_new_from_file_at_scale (filename, MIN (d_width, i_width),
+						    MIN (d_height, i_height), FALSE, &e);
+      else
+	pixbuf = gdk_pixbuf_new_from_file (filename, &e);
+    }
+  else
+    pixbuf = gdk_pixbuf_new_from_file (filename, &e);
+  if (!pixbuf)
+    {
+      g_warning ("Failed to load image %s: %s", filename, e->message);
+      g_error_free (e);
+      
+      return;
+    }
+  i_width = gdk_pixbuf_get_width (pixbuf);
+  i_height = gdk_pixbuf_get_height (pixbuf);
+  
+  cairo_save (cr);
+  cairo_scale (cr, width / i_width, height / i_height);
+  
+  gdk_cairo_set_source_pixbuf (cr, pixbuf, 0, 0);
+  
+  if (format && !raster)
+    {
+      gchar **mime_types = gdk_pixbuf_format_get_mime_types (format);
+      
+      if (mime_types && mime_types[0])
+	mime_type = g_strdup (mime_types[0]);
+      g_strfreev (mime_types);
+    }
+  
+#ifdef CAIRO_MIME_TYPE_JPEG
+  if (mime_type && !strcmp (mime_type, "image/jpeg"))
+    {
+      cairo_surface_t *surface;
+      gchar *data;
+      gsize length;
+      
+      cairo_pattern_get_surface (cairo_get_source (cr), &surface);
+      if (g_file_get_contents (filename, &data, &length, NULL))
+	cairo_surface_set_mime_data (surface, CAIRO_MIME_TYPE_JPEG,
+				     (guchar *) data, length, g_free, data);
+    }
+#endif
+  g_free (mime_type);
+  
+  cairo_rectangle (cr, 0, 0, i_width, i_height);
+  cairo_clip (cr);
+  cairo_paint_with_alpha (cr, alpha);
+  
+  cairo_restore (cr);
+  g_object_unref (pixbuf);
+}
+
+static void
+glide_cairo_util_draw_text (cairo_t *cr,
+			    GlideText *text,
+			    gdouble width,
+			    gdouble height,
+			    gdouble alpha)
+{
+  PangoLayout *source = glide_text_get_layout (text);
+  PangoLayout *layout;
+  ClutterColor color;
+  
+  if (!pango_layout_get_text (source))
+    return;
+  
+  // A fresh layout, so that fonts are loaded for this cairo context.
+  layout = pango_cairo_create_layout (cr);
+  pango_cairo_context_set_resolution (pango_layout_get_context (layout),
+				      clutter_backend_get_resolution (clutter_get_default_backend ()));
+  pango_layout_context_changed (layout);
+  
+  pango_layout_set_font_description (layout, glide_text_get_font_description (text));
+  pango_layout_set_text (layout, pango_layout_get_text (source), -1);
+  pango_layout_set_attributes (layout, pango_layout_get_attributes (source));
+  pango_layout_set_alignment (layout, pango_layout_get_alignment (source));
+  pango_layout_set_justify (layout, pango_layout_get_justify (source));
+  pango_layout_set_wrap (layout, pango_layout_get_wrap (source));
+  pango_layout_set_ellipsize (layout, pango_layout_get_ellipsize (source));
+  pango_layout_set_single_paragraph_mode (layout, pango_layout_get_single_paragraph_mode (source));
+  pango_layout_set_width (layout, pango_layout_get_width (source));
+  pango_layout_set_height (layout, pango_layout_get_height (source));
+  
+  glide_text_get_color (text, &color);
+  
+  cairo_save (cr);
+  cairo_rectangle (cr, 0, 0, width, height);
+  cairo_clip (cr);
+  
+  cairo_set_source_rgba (cr, color.red / 255.0, color.green / 255.0,
+			 color.blue / 255.0, alpha * color.alpha / 255.0);
+  pango_cairo_show_layout (cr, layout);
+  
+  cairo_restore (cr);
+  g_object_unref (layout);
+}
+
+static void
+glide_cairo_util_draw_actor (cairo_t *cr, ClutterActor *actor)
+{
+  gfloat x, y, a_width, a_height, cx, cy;
+  gdouble alpha, angle;
+  
+  clutter_actor_get_position (actor, &x, &y);
+  clutter_actor_get_size (actor, &a_width, &a_height);
+  alpha = clutter_actor_get_opacity (actor) / 255.0;
+  angle = clutter_actor_get_rotation (actor, CLUTTER_Z_AXIS, &cx, &cy, NULL);
+  
+  cairo_save (cr);
+  cairo_translate (cr, x, y);
+  if (angle != 0)
+    {
+      cairo_translate (cr, cx, cy);
+      cairo_rotate (cr, angle * G_PI / 180.0);
+      cairo_translate (cr, -cx, -cy);
+    }
+  
+  if (GLIDE_IS_TEXT (actor))
+    glide_cairo_util_draw_text (cr, GLIDE_TEXT (actor), a_width, a_height, alpha);
+  else if (glide_image_get_filename (GLIDE_IMAGE (actor)))
+    glide_cairo_util_draw_image_file (cr, glide_image_get_filename (GLIDE_IMAGE (actor)),
+				      a_width, a_height, alpha);
+  
+  cairo_restore (cr);
+}
+
+static gboolean
+glide_cairo_util_can_draw_json (JsonArray *actors)
+{
+  guint i;
+  
+  for (i = 0; i < json_array_get_length (actors); i++)
+    {
+      const gchar *type = glide_json_object_get_string (json_array_get_object_element (actors, i),
+							"type");
+      
+      if (g_strcmp0 (type, "text") && g_strcmp0 (type, "image"))
+	{
+	  GLIDE_NOTE (PAINT, "Can't draw %s with cairo", type);
+	  return FALSE;
+	}
+    }
+  return TRUE;
+}
+
+/*
+ * Draws the actors a slide was loaded with without building it. Images
+ * only need their file, text goes through a GlideText of its own which
+ * is dropped straight away.
+ */
+static void
+glide_cairo_util_draw_json (cairo_t *cr, JsonArray *actors)
+{
+  guint i;
+  
+  for (i = 0; i < json_array_get_length (actors); i++)
+    {
+      JsonObject *actor_obj = json_array_get_object_element (actors, i);
+      
+      if (!g_strcmp0 (glide_json_object_get_string (actor_obj, "type"), "image"))
+	{
+	  gdouble x, y, width, height;
+	  const gchar *filename = NULL;
+	  
+	  if (json_object_has_member (actor_obj, "image-properties"))
+	    filename = glide_json_object_get_string (json_object_get_object_member (actor_obj, "image-properties"),
+						     "filename");
+	  if (!filename || !glide_json_object_get_geometry (actor_obj, &x, &y, &width, &height))
+	    continue;
+	  
+	  cairo_save (cr);
+	  cairo_translate (cr, x, y);
+	  glide_cairo_util_draw_image_file (cr, filename, width, height, 1.0);
+	  cairo_restore (cr);
+	}
+      else
+	{
+	  ClutterActor *actor = CLUTTER_ACTOR (glide_actor_construct_from_json (actor_obj));
+	  
+	  g_object_ref_sink (actor);
+	  glide_cairo_util_draw_actor (cr, actor);
+	  clutter_actor_destroy (actor);
+	  g_object_unref (actor);
+	}
+    }
+}
+
+/*
+ * Draws slide with native cairo operations, for resolution
+ * independent output. Returns FALSE if the slide holds an actor
+ * we don't know how to draw, or one rotated out of the plane of the
+ * slide, leaving the caller to fall back to rendering it with GL.
+ * Slides which were never shown are drawn from the JSON they were
+ * loaded with, and stay that way.
+ */
+gboolean
+glide_cairo_util_draw_slide (cairo_t *cr, GlideSlide *slide)
+{
+  const gchar *background;
+  ClutterColor color;
+  gfloat width, height, p_width, p_height;
+  GList *children = NULL, *c;
+  JsonObject *pending;
+  JsonArray *actors = NULL;
+  
+  pending = glide_slide_get_pending_json (slide, &p_width, &p_height);
+  if (pending && json_object_has_member (pending, "actors"))
+    actors = json_object_get_array_member (pending, "actors");
+  if (pending && actors && !glide_cairo_util_can_draw_json (actors))
+    return FALSE;
+  
+  if (!pending)
+    children = clutter_container_get_children (CLUTTER_CONTAINER (glide_slide_get_contents (slide)));
+  for (c = children; c; c = c->next)
+    {
+      ClutterActor *actor = CLUTTER_ACTOR (c->data);
+      
+      // The manipulator lives in the contents of the current slide.
+      if (!GLIDE_IS_ACTOR (actor))
+	continue;
+      
+      if ((!GLIDE_IS_TEXT (actor) && !GLIDE_IS_IMAGE (actor)) ||
+	  clutter_actor_get_rotation (actor, CLUTTER_X_AXIS, NULL, NULL, NULL) != 0 ||
+	  clutter_actor_get_rotation (actor, CLUTTER_Y_AXIS, NULL, NULL, NULL) != 0)
+	{
+	  GLIDE_NOTE (PAINT, "Can't draw %s with cairo", G_OBJECT_TYPE_NAME (actor));
+	  g_list_free (children);
+	  
+	  return FALSE;
+	}
+    }
+  
+  clutter_actor_get_size (CLUTTER_ACTOR (slide), &width, &height);
+  
+  glide_slide_get_color (slide, &color);
+  cairo_set_source_rgba (cr, color.red / 255.0, color.green / 255.0,
+			 color.blue / 255.0, color.alpha / 255.0);
+  cairo_rectangle (cr, 0, 0, width, height);
+  cairo_fill (cr);
+  
+  background = glide_slide_get_background (slide);
+  if (background)
+    glide_cairo_util_draw_image_file (cr, background, width, height, 1.0);
+  
+  if (actors)
+    {
+      // Loaded at another size if the document was resized since.
+      cairo_save (cr);
+      if (p_width > 0 && p_height > 0)
+	cairo_scale (cr, width / p_width, height / p_height);
+      glide_cairo_util_draw_json (cr, actors);
+      cairo_restore (cr);
+    }
+  
+  for (c = children; c; c = c->next)
+    if (GLIDE_IS_ACTOR (c->data) && CLUTTER_ACTOR_IS_VISIBLE (c->data))
+      glide_cairo_util_draw_actor (cr, CLUTTER_ACTOR (c->data));
+  g_list_free (children);
+  
+  return TRUE;
+}
+
+/* Copies an RGB24 or ARGB32 image surface into a pixbuf without alpha */
+GdkPixbuf *
+glide_cairo_util_surface_to_pixbuf (cairo_surface_t *surface)
+{
+  gint width = cairo_image_surface_get_width (surface);
+  gint height = cairo_image_surface_get_height (surface);
+  gint stride = cairo_image_surface_get_stride (surface);
+  guchar *data = cairo_image_surface_get_data (surface);
+  GdkPixbuf *pixbuf;
+  gint x, y;
+  
+  cairo_surface_flush (surface);
+  
+  pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, FALSE, 8, width, height);
+  for (y = 0; y < height; y++)
+    {
+      guint32 *src = (guint32 *) (data + y * stride);
+      guchar *dest = gdk_pixbuf_get_pixels (pixbuf) + y * gdk_pixbuf_get_rowstride (pixbuf);
+      
+      for (x = 0; x < width; x++)
+	{
+	  *dest++ = (src[x] >> 16) & 0xff;
+	  *dest++ = (src[x] >> 8) & 0xff;
+	  *dest++ = src[x] & 0xff;
+	}
+    }
+  
+  return pixbuf;
+}
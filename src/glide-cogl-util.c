@@ -0,0 +1,111 @@
+/*
+ * glide-cogl-util.c
+ * This file is part of glide
+ *
+ * Copyright (C) 2010 - Robert Carr
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, 
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "glide-cogl-util.h"
+
+#include "glide-debug.h"
+
+static CoglHandle
+glide_cogl_util_render_actor_real (ClutterActor *actor,
+				   gfloat width,
+				   gfloat height,
+				   gfloat aspect,
+				   gfloat scale_x,
+				   gfloat scale_y)
+{
+  ClutterActor *stage = clutter_actor_get_stage (actor);
+  ClutterPerspective perspective;
+  CoglHandle texture, offscreen;
+  CoglColor clear;
+  
+  if (!stage || !cogl_features_available (COGL_FEATURE_OFFSCREEN))
+    return COGL_INVALID_HANDLE;
+  
+  clutter_stage_ensure_current (CLUTTER_STAGE (stage));
+  
+  texture = cogl_texture_new_with_size (width, height,
+					COGL_TEXTURE_NO_SLICING,
+					COGL_PIXEL_FORMAT_RGBA_8888_PRE);
+  if (texture == COGL_INVALID_HANDLE)
+    return COGL_INVALID_HANDLE;
+  
+  offscreen = cogl_offscreen_new_to_texture (texture);
+  if (offscreen == COGL_INVALID_HANDLE)
+    {
+      cogl_handle_unref (texture);
+      return COGL_INVALID_HANDLE;
+    }
+  
+  clutter_stage_get_perspective (CLUTTER_STAGE (stage), &perspective);
+  
+  cogl_push_framebuffer (offscreen);
+  cogl_setup_viewport (width, height,
+		       perspective.fovy, aspect ? aspect : perspective.aspect,
+		       perspective.z_near, perspective.z_far);
+  
+  cogl_color_set_from_4ub (&clear, 0, 0, 0, 0);
+  cogl_clear (&clear, COGL_BUFFER_BIT_COLOR | COGL_BUFFER_BIT_DEPTH);
+  
+  cogl_scale (scale_x, scale_y, 1);
+  clutter_actor_paint (actor);
+  
+  cogl_pop_framebuffer ();
+  cogl_handle_unref (offscreen);
+  
+  GLIDE_NOTE (PAINT, "Rendered actor %p to a %fx%f texture", actor, width, height);
+  
+  return texture;
+}
+
+/*
+ * Paints actor into a new texture of the given size, using the
+ * projection of its stage. Returns COGL_INVALID_HANDLE when offscreen
+ * rendering isn't supported.
+ */
+CoglHandle
+glide_cogl_util_render_actor_to_texture (ClutterActor *actor,
+					 gfloat width,
+					 gfloat height)
+{
+  return glide_cogl_util_render_actor_real (actor, width, height, 0, 1, 1);
+}
+
+/*
+ * As above, but stretches the actor to fill a texture of any size,
+ * whatever the size of the stage.
+ */
+CoglHandle
+glide_cogl_util_render_actor_scaled (ClutterActor *actor,
+				     gint width,
+				     gint height)
+{
+  gfloat a_width, a_height;
+  
+  clutter_actor_get_size (actor, &a_width, &a_height);
+  if (a_width <= 0 || a_height <= 0)
+    return COGL_INVALID_HANDLE;
+  
+  return glide_cogl_util_render_actor_real (actor, width, height,
+					    (gfloat) width / height,
+					    width / a_width,
+					    height / a_height);
+}
@@ -0,0 +1,78 @@
+/*
+ * glide-debug.c
+ * This file is part of glide
+ *
+ * Copyright (C) 2010 - Robert Carr
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "glide-debug.h"
+
+guint glide_debug_flags = 0;
+
+#ifdef GLIDE_ENABLE_DEBUG
+static const GDebugKey glide_debug_keys[] = {
+  {"misc", GLIDE_DEBUG_MISC},
+  {"image", GLIDE_DEBUG_IMAGE},
+  {"manipulator", GLIDE_DEBUG_MANIPULATOR},
+  {"stage-manager", GLIDE_DEBUG_STAGE_MANAGER},
+  {"window", GLIDE_DEBUG_WINDOW},
+  {"paint", GLIDE_DEBUG_PAINT},
+  {"text", GLIDE_DEBUG_TEXT},
+  {"document", GLIDE_DEBUG_DOCUMENT}
+};
+
+static gboolean
+glide_arg_debug_cb (const char *key, const char *value, gpointer user_data)
+{
+  glide_debug_flags |=
+	g_parse_debug_string (value, glide_debug_keys, G_N_ELEMENTS (glide_debug_keys));
+  return TRUE;
+}
+
+static gboolean
+glide_arg_no_debug_cb (const char *key, const char *value, gpointer user_data)
+{
+  glide_debug_flags &=
+	~g_parse_debug_string (value, glide_debug_keys, G_N_ELEMENTS (glide_debug_keys));
+  return TRUE;
+}
+#endif
+
+static GOptionEntry glide_debug_args[] = {
+#ifdef GLIDE_ENABLE_DEBUG
+  {"glide-debug", 0, 0, G_OPTION_ARG_CALLBACK, glide_arg_debug_cb,
+   "Glide debugging messages to show. Comma seperated list of: all, misc, image, manipulator, stage-manager, window, text, document, or paint",
+   "FLAGS"},
+  {"glide-no-debug", 0, 0, G_OPTION_ARG_CALLBACK, glide_arg_no_debug_cb,
+   "Disable glide debugging", "FLAGS"},
+#endif
+  {NULL,},
+};
+
+/* The --glide-debug options, shared by glide and the tools built with it */
+GOptionGroup *
+glide_debug_get_option_group (void)
+{
+  GOptionGroup *group;
+  
+  group = g_option_group_new ("glide-debug", "Glide Debugging Options",
+			      "Show Glide debugging options", NULL, NULL);
+  g_option_group_add_entries (group, glide_debug_args);
+  
+  return group;
+}
@@ -60,4 +60,6 @@ typedef enum
 
 extern guint glide_debug_flags;
 
+GOptionGroup *glide_debug_get_option_group (void);
+
 #endif
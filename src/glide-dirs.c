@@ -45,3 +45,9 @@ glide_dirs_get_glide_ui_dir ()
   g_free (datadir);
   return uidir;
 }
+
+gchar *
+glide_dirs_get_glide_cache_dir ()
+{
+  return g_build_filename (g_get_user_cache_dir (), "glide", NULL);
+}
@@ -31,4 +31,7 @@ glide_dirs_get_glide_image_dir (void);
 gchar *
 glide_dirs_get_glide_ui_dir (void);
 
+gchar *
+glide_dirs_get_glide_cache_dir (void);
+
 #endif
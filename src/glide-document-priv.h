@@ -29,7 +29,8 @@ G_BEGIN_DECLS
 
 struct _GlideDocumentPrivate
 {
-  GList *slides;
+  /* Indexed by slide number, owns no references. */
+  GPtrArray *slides;
 
   gchar *name;
   gchar *path;
@@ -24,6 +24,12 @@
 #include "glide-document-priv.h"
 
 #include <girepository.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include "glide-debug.h"
 
@@ -48,6 +54,7 @@ enum {
 enum {
   SLIDE_ADDED,
   SLIDE_REMOVED,
+  SLIDE_CHANGED,
   RESIZED,
   LAST_SIGNAL
 };
@@ -63,6 +70,7 @@ glide_document_finalize (GObject *object)
 	      document->priv->name);
   
   g_free (document->priv->name);
+  g_ptr_array_free (document->priv->slides, TRUE);
 
   G_OBJECT_CLASS (glide_document_parent_class)->finalize (object);
 }
@@ -110,10 +118,7 @@ glide_document_set_property (GObject *object,
   switch (prop_id)
     {
     case PROP_NAME:
-      g_return_if_fail (document->priv->name == NULL);
-      document->priv->name = g_value_dup_string (value);
-      GLIDE_NOTE (DOCUMENT, "Constructing new GlideDocument (%p): %s",
-		  object, document->priv->name);
+      glide_document_set_name (document, g_value_get_string (value));
       break;
     case PROP_WIDTH:
       document->priv->width = g_value_get_int (value);
@@ -150,8 +155,7 @@ glide_document_class_init (GlideDocumentClass *klass)
 							"Name of the document",
 							NULL,
 							G_PARAM_READWRITE |
-							G_PARAM_STATIC_STRINGS |
-							G_PARAM_CONSTRUCT_ONLY));
+							G_PARAM_STATIC_STRINGS));
   g_object_class_install_property (object_class, PROP_PATH,
 				   g_param_spec_string ("path",
 							"Path",
@@ -206,6 +210,17 @@ glide_document_class_init (GlideDocumentClass *klass)
 		  G_TYPE_NONE, 1,
 		  G_TYPE_OBJECT);
   
+  /* Emitted by glide_slide_mark_dirty, for anything saved */
+  document_signals[SLIDE_CHANGED] =
+    g_signal_new ("slide-changed",
+		  G_TYPE_FROM_CLASS (object_class),
+		  G_SIGNAL_RUN_LAST,
+		  0,
+		  NULL, NULL,
+		  gi_cclosure_marshal_generic,
+		  G_TYPE_NONE, 1,
+		  G_TYPE_OBJECT);
+  
   document_signals[RESIZED] = 
     g_signal_new ("resized",
 		  G_TYPE_FROM_CLASS (object_class),
@@ -223,6 +238,7 @@ static void
 glide_document_init (GlideDocument *d)
 {
   d->priv = GLIDE_DOCUMENT_GET_PRIVATE (d);
+  d->priv->slides = g_ptr_array_new ();
   
   //  glide_document_add_slide (d);
 }
@@ -241,6 +257,18 @@ glide_document_get_name (GlideDocument *document)
   return document->priv->name;
 }
 
+void
+glide_document_set_name (GlideDocument *document, const gchar *name)
+{
+  GLIDE_NOTE (DOCUMENT, "Setting name of GlideDocument (%p): %s",
+	      document, name);
+  
+  g_free (document->priv->name);
+  document->priv->name = g_strdup (name);
+  
+  g_object_notify (G_OBJECT (document), "name");
+}
+
 const gchar *
 glide_document_get_path (GlideDocument *document)
 {
@@ -250,6 +278,7 @@ glide_document_get_path (GlideDocument *document)
 void
 glide_document_set_path (GlideDocument *document, const gchar *path)
 {
+  g_free (document->priv->path);
   document->priv->path = g_strdup (path);
   g_object_notify (G_OBJECT (document), "path");
 }
@@ -257,21 +286,67 @@ glide_document_set_path (GlideDocument *document, const gchar *path)
 guint
 glide_document_get_n_slides (GlideDocument *document)
 {
-  return g_list_length (document->priv->slides);
+  return document->priv->slides->len;
 }
 
 GlideSlide *
 glide_document_get_nth_slide (GlideDocument *document,
 			      guint n)
 {
-  return GLIDE_SLIDE (g_list_nth_data (document->priv->slides, n));
+  if (n >= document->priv->slides->len)
+    return NULL;
+  return GLIDE_SLIDE (g_ptr_array_index (document->priv->slides, n));
+}
+
+/* GPtrArray has no insert in the GLib we target */
+static void
+glide_document_slides_open_gap (GlideDocument *document, guint position, guint n_slides)
+{
+  GPtrArray *slides = document->priv->slides;
+  guint old_len = slides->len;
+  
+  g_ptr_array_set_size (slides, old_len + n_slides);
+  memmove (slides->pdata + position + n_slides, slides->pdata + position,
+	   (old_len - position) * sizeof (gpointer));
+}
+
+guint
+glide_document_insert_slides (GlideDocument *document, gint after, guint n_slides)
+{
+  GPtrArray *slides = document->priv->slides;
+  guint first, i;
+  
+  if (after < -1)
+    after = -1;
+  first = MIN ((guint)(after + 1), slides->len);
+  
+  glide_document_slides_open_gap (document, first, n_slides);
+  for (i = first; i < first + n_slides; i++)
+    g_ptr_array_index (slides, i) = glide_slide_new (document);
+  
+  GLIDE_NOTE (DOCUMENT, "Inserted %u slides at %u (%u total)",
+	      n_slides, first, slides->len);
+  
+  for (i = first; i < first + n_slides; i++)
+    g_signal_emit (document, document_signals[SLIDE_ADDED], 0,
+		   g_ptr_array_index (slides, i));
+  
+  return first;
+}
+
+guint
+glide_document_append_slides (GlideDocument *document, guint n_slides)
+{
+  return glide_document_insert_slides (document, 
+				       (gint)document->priv->slides->len - 1,
+				       n_slides);
 }
 
 GlideSlide *
 glide_document_append_slide (GlideDocument *document)
 {
   GlideSlide *s = glide_slide_new (document);
-  document->priv->slides = g_list_append (document->priv->slides, s);
+  g_ptr_array_add (document->priv->slides, s);
   
   g_signal_emit (document, document_signals[SLIDE_ADDED], 0, s);
   
@@ -281,21 +356,38 @@ glide_document_append_slide (GlideDocument *document)
 GlideSlide *
 glide_document_insert_slide (GlideDocument *document, gint after)
 {
-  GlideSlide *s = glide_slide_new (document);
-  document->priv->slides = g_list_insert (document->priv->slides, s, after+1);
+  guint first = glide_document_insert_slides (document, after, 1);
   
-  g_signal_emit (document, document_signals[SLIDE_ADDED], 0, s);
+  return glide_document_get_nth_slide (document, first);
+}
+
+void
+glide_document_remove_slides (GlideDocument *document, guint first, guint n_slides)
+{
+  GPtrArray *slides = document->priv->slides;
+  GlideSlide **removed;
+  guint i;
   
-  return s;
+  if (first >= slides->len)
+    return;
+  n_slides = MIN (n_slides, slides->len - first);
+  
+  removed = g_new (GlideSlide *, n_slides);
+  memcpy (removed, slides->pdata + first, n_slides * sizeof (gpointer));
+  g_ptr_array_remove_range (slides, first, n_slides);
+  
+  for (i = 0; i < n_slides; i++)
+    g_signal_emit (document, document_signals[SLIDE_REMOVED], 0, removed[i]);
+  
+  g_free (removed);
 }
 
 void
 glide_document_remove_slide (GlideDocument *document, gint slide)
 {
-  GlideSlide *s = g_list_nth_data (document->priv->slides, slide);
-  document->priv->slides = g_list_remove (document->priv->slides, s);
-
-  g_signal_emit (document, document_signals[SLIDE_REMOVED], 0, s);
+  if (slide < 0)
+    return;
+  glide_document_remove_slides (document, slide, 1);
 }
 
 static void
@@ -312,22 +404,34 @@ glide_document_json_obj_set_slides (GlideDocument *document, JsonObject *obj)
 {
   JsonNode *node = json_node_new (JSON_NODE_ARRAY);
   JsonArray *array = json_array_new ();
-  GList *s;
+  guint i, n_dirty = 0;
   
-  for (s = document->priv->slides; s; s = s->next)
+  // Slides hold on to their JSON until they change, so only edited
+  // slides cost anything here.
+  for (i = 0; i < document->priv->slides->len; i++)
     {
       JsonNode *n;
-      GlideSlide *slide = (GlideSlide *)(s->data);
+      GlideSlide *slide = GLIDE_SLIDE (g_ptr_array_index (document->priv->slides, i));
+      
+      if (glide_slide_get_dirty (slide))
+	n_dirty++;
       
       n = glide_actor_serialize (GLIDE_ACTOR (slide));
       json_array_add_element (array, n);
     }
   json_node_take_array (node, array);
+  
+  GLIDE_NOTE (DOCUMENT, "Serialized %u of %u slides", n_dirty, document->priv->slides->len);
 
   json_object_set_member (obj, "slides", node);
   
 }
 
+/*
+ * Version 1 files have no version member, and store numbers as
+ * strings. Version 2 uses JSON numbers, and [x, y, width, height]
+ * arrays for geometry.
+ */
 JsonNode *
 glide_document_serialize(GlideDocument *document)
 {
@@ -337,12 +441,224 @@ glide_document_serialize(GlideDocument *document)
   obj = json_object_new ();
   json_node_set_object (node, obj);
   
+  json_object_set_int_member (obj, "version", GLIDE_DOCUMENT_SCHEMA_VERSION);
   glide_document_json_obj_set_name (document, obj);
   glide_document_json_obj_set_slides (document, obj);
   
   return node;
 }
 
+/*
+ * Writes data next to filename, flushes it to disk and renames it
+ * over filename, so a crash leaves either the old document or the new
+ * one. Only touches the filesystem, so is safe to call from any
+ * thread.
+ */
+static gboolean
+glide_document_write_atomically (const gchar *filename,
+				 const gchar *data,
+				 gsize length,
+				 GError **error)
+{
+  gchar *tmp_name = g_strdup_printf ("%s.XXXXXX", filename);
+  gchar *dir;
+  struct stat st;
+  gint fd, save_errno;
+  
+  fd = g_mkstemp (tmp_name);
+  if (fd < 0)
+    {
+      save_errno = errno;
+      g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (save_errno),
+		   "Failed to create file '%s': %s", tmp_name, g_strerror (save_errno));
+      g_free (tmp_name);
+      return FALSE;
+    }
+  
+  // g_mkstemp creates the file readable only by us.
+  if (g_stat (filename, &st) == 0)
+    fchmod (fd, st.st_mode & 0777);
+  else
+    fchmod (fd, 0644);
+  
+  while (length > 0)
+    {
+      gssize written = write (fd, data, length);
+      
+      if (written < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  goto fail;
+	}
+      data += written;
+      length -= written;
+    }
+  
+  if (fsync (fd) != 0)
+    goto fail;
+  if (close (fd) != 0)
+    {
+      fd = -1;
+      goto fail;
+    }
+  fd = -1;
+  
+  if (g_rename (tmp_name, filename) != 0)
+    goto fail;
+  
+  // Make the rename itself durable.
+  dir = g_path_get_dirname (filename);
+  fd = g_open (dir, O_RDONLY, 0);
+  if (fd >= 0)
+    {
+      fsync (fd);
+      close (fd);
+    }
+  g_free (dir);
+  
+  g_free (tmp_name);
+  return TRUE;
+  
+ fail:
+  save_errno = errno;
+  g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (save_errno),
+	       "Failed to write file '%s': %s", filename, g_strerror (save_errno));
+  if (fd >= 0)
+    close (fd);
+  g_unlink (tmp_name);
+  g_free (tmp_name);
+  
+  return FALSE;
+}
+
+/* Serializes document straight to text, dropping the tree it was built from */
+static gchar *
+glide_document_generate (GlideDocument *document,
+			 gboolean pretty,
+			 gsize *length)
+{
+  JsonGenerator *gen = json_generator_new ();
+  JsonNode *node = glide_document_serialize (document);
+  gchar *data;
+  
+  g_object_set (gen, "pretty", pretty, NULL);
+  json_generator_set_root (gen, node);
+  
+  data = json_generator_to_data (gen, length);
+  
+  json_node_free (node);
+  g_object_unref (gen);
+  
+  return data;
+}
+
+gboolean
+glide_document_write_to_file (GlideDocument *document,
+			      const gchar *filename,
+			      gboolean pretty,
+			      GError **error)
+{
+  gchar *data;
+  gsize length;
+  gboolean ret;
+  
+  data = glide_document_generate (document, pretty, &length);
+  ret = glide_document_write_atomically (filename, data, length, error);
+  g_free (data);
+  
+  return ret;
+}
+
+typedef struct _GlideDocumentSaveJob {
+  GlideDocument *document;
+  gchar *filename;
+  gchar *data;
+  gsize length;
+  
+  GlideDocumentSaveCallback callback;
+  gpointer user_data;
+  
+  GError *error;
+  GTimer *timer;
+} GlideDocumentSaveJob;
+
+static GThreadPool *save_pool = NULL;
+
+static gboolean
+glide_document_save_done (gpointer data)
+{
+  GlideDocumentSaveJob *job = (GlideDocumentSaveJob *)data;
+  
+  GLIDE_NOTE (DOCUMENT, "Saved %s in %f seconds%s", job->filename,
+	      g_timer_elapsed (job->timer, NULL), job->error ? " (failed)" : "");
+  
+  if (job->callback)
+    job->callback (job->document, job->filename, job->error, job->user_data);
+  
+  if (job->error)
+    g_error_free (job->error);
+  g_timer_destroy (job->timer);
+  g_object_unref (job->document);
+  g_free (job->filename);
+  g_slice_free (GlideDocumentSaveJob, job);
+  
+  return FALSE;
+}
+
+static void
+glide_document_save_func (gpointer data, gpointer user_data)
+{
+  GlideDocumentSaveJob *job = (GlideDocumentSaveJob *)data;
+  
+  glide_document_write_atomically (job->filename, job->data, job->length, &job->error);
+  
+  g_free (job->data);
+  job->data = NULL;
+  
+  g_idle_add (glide_document_save_done, job);
+}
+
+/*
+ * Generates the JSON of document now, and writes it on a worker
+ * thread. callback is called from the main loop once the file is in
+ * place, or with error set if it couldn't be written. Saves run one at
+ * a time in the order they were started.
+ *
+ * The tree shares the JSON slides keep from loading or from their last
+ * serialization, and json-glib's reference counts aren't atomic, so
+ * only the text ever leaves the main thread.
+ */
+void
+glide_document_write_to_file_async (GlideDocument *document,
+				    const gchar *filename,
+				    gboolean pretty,
+				    GlideDocumentSaveCallback callback,
+				    gpointer user_data)
+{
+  GlideDocumentSaveJob *job = g_slice_new0 (GlideDocumentSaveJob);
+  
+  job->timer = g_timer_new ();
+  job->document = g_object_ref (document);
+  job->filename = g_strdup (filename);
+  job->data = glide_document_generate (document, pretty, &job->length);
+  job->callback = callback;
+  job->user_data = user_data;
+  
+  GLIDE_NOTE (DOCUMENT, "Serialized %s for saving in %f seconds", filename,
+	      g_timer_elapsed (job->timer, NULL));
+  
+  if (!save_pool)
+    save_pool = g_thread_pool_new (glide_document_save_func, NULL, 1, FALSE, NULL);
+  g_thread_pool_push (save_pool, job, NULL);
+}
+
+void
+glide_document_slide_changed (GlideDocument *document, GlideSlide *slide)
+{
+  g_signal_emit (document, document_signals[SLIDE_CHANGED], 0, slide);
+}
+
 gint 
 glide_document_get_height (GlideDocument *document)
 {
@@ -365,18 +681,18 @@ glide_document_get_size (GlideDocument *document, gint *width, gint *height)
 void
 glide_document_resize (GlideDocument *document, gint width, gint height)
 {
-  GList *s;
+  guint i;
 
   document->priv->width = width;
   document->priv->height = height;
 
   g_signal_emit (document, document_signals[RESIZED], 0);  
 
-  for (s=document->priv->slides; s; s=s->next)
+  for (i = 0; i < document->priv->slides->len; i++)
     {
-            GlideSlide *slide = (GlideSlide *)s->data;
+      GlideSlide *slide = GLIDE_SLIDE (g_ptr_array_index (document->priv->slides, i));
 
-	    glide_slide_resize (slide, width, height);
+      glide_slide_resize (slide, width, height);
     }
 }
 
@@ -32,6 +32,9 @@
 
 G_BEGIN_DECLS
 
+/* Bumped whenever the saved format changes, see glide_document_serialize */
+#define GLIDE_DOCUMENT_SCHEMA_VERSION 2
+
 /*
  * Type checking and casting macros
  */
@@ -67,6 +70,11 @@ struct _GlideDocumentClass
   GObjectClass parent_class;
 };
 
+typedef void (*GlideDocumentSaveCallback) (GlideDocument *document,
+					   const gchar *filename,
+					   const GError *error,
+					   gpointer user_data);
+
 /*
  * Public methods
  */
@@ -75,6 +83,7 @@ GType 		 glide_document_get_type 			(void) G_GNUC_CONST;
 GlideDocument   *glide_document_new (const gchar *name);
 
 const gchar     *glide_document_get_name (GlideDocument *document);
+void glide_document_set_name (GlideDocument *document, const gchar *name);
 const gchar     *glide_document_get_path (GlideDocument *document);
 void glide_document_set_path (GlideDocument *document, const gchar *path);
 
@@ -84,9 +93,18 @@ GlideSlide *glide_document_get_nth_slide (GlideDocument *document, guint n);
 GlideSlide *glide_document_append_slide (GlideDocument *document);
 GlideSlide *glide_document_insert_slide (GlideDocument *document, gint after);
 
+guint glide_document_append_slides (GlideDocument *document, guint n_slides);
+guint glide_document_insert_slides (GlideDocument *document, gint after, guint n_slides);
+
 void glide_document_remove_slide (GlideDocument *document, gint slide);
+void glide_document_remove_slides (GlideDocument *document, guint first, guint n_slides);
+
+void glide_document_slide_changed (GlideDocument *document, GlideSlide *slide);
 
 JsonNode *glide_document_serialize (GlideDocument *document);
+gboolean glide_document_write_to_file (GlideDocument *document, const gchar *filename, gboolean pretty, GError **error);
+void glide_document_write_to_file_async (GlideDocument *document, const gchar *filename, gboolean pretty,
+					 GlideDocumentSaveCallback callback, gpointer user_data);
 
 gint glide_document_get_height (GlideDocument *document);
 gint glide_document_get_width (GlideDocument *document);
@@ -0,0 +1,537 @@
+/*
+ * glide-export.c
+ * This file is part of glide
+ *
+ * Copyright (C) 2010 - Robert Carr
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, 
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <errno.h>
+
+#include <glib/gstdio.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <json-glib/json-glib.h>
+
+#include <cairo.h>
+#include <cairo-pdf.h>
+
+#include "glide-export.h"
+
+#include "glide-slide.h"
+#include "glide-image.h"
+#include "glide-cogl-util.h"
+#include "glide-cairo-util.h"
+
+#include "glide-debug.h"
+
+GQuark
+glide_export_error_quark (void)
+{
+  return g_quark_from_static_string ("glide-export-error-quark");
+}
+
+static void
+glide_export_prepare_actor (ClutterActor *actor, gpointer user_data)
+{
+  GError *e = NULL;
+  
+  if (!GLIDE_IS_IMAGE (actor))
+    return;
+  
+  if (!glide_image_ensure_texture (GLIDE_IMAGE (actor), &e) && e)
+    {
+      g_warning ("Failed to load image for export: %s", e->message);
+      g_error_free (e);
+    }
+}
+
+/*
+ * Paints the slide into an offscreen buffer and reads it back in the
+ * layout cairo uses, so no conversion is needed on our side.
+ */
+static cairo_surface_t *
+glide_export_render_slide (GlideSlide *slide, gint width, gint height)
+{
+  ClutterActor *actor = CLUTTER_ACTOR (slide);
+  cairo_surface_t *surface;
+  ClutterActorBox box;
+  CoglHandle texture;
+  gboolean visible;
+  gint stride;
+  
+  glide_slide_materialize (slide);
+  clutter_container_foreach (CLUTTER_CONTAINER (glide_slide_get_contents (slide)),
+			     glide_export_prepare_actor, NULL);
+  
+  // Unmapped actors don't paint, so show the slide for as long as we need it.
+  visible = CLUTTER_ACTOR_IS_VISIBLE (actor);
+  if (!visible)
+    clutter_actor_show (actor);
+  clutter_actor_get_allocation_box (actor, &box);
+  
+  texture = glide_cogl_util_render_actor_scaled (actor, width, height);
+  
+  if (!visible)
+    clutter_actor_hide (actor);
+  
+  if (texture == COGL_INVALID_HANDLE)
+    return NULL;
+  
+  surface = cairo_image_surface_create (CAIRO_FORMAT_RGB24, width, height);
+  stride = cairo_image_surface_get_stride (surface);
+  
+  cairo_surface_flush (surface);
+  cogl_texture_get_data (texture,
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+			 COGL_PIXEL_FORMAT_BGRA_8888_PRE,
+#else
+			 COGL_PIXEL_FORMAT_ARGB_8888_PRE,
+#endif
+			 stride,
+			 cairo_image_surface_get_data (surface));
+  cairo_surface_mark_dirty (surface);
+  
+  cogl_handle_unref (texture);
+  
+  return surface;
+}
+
+static gboolean
+glide_export_pdf_real (GlideDocument *document,
+		       const gchar *filename,
+		       gint width,
+		       gint height,
+		       gboolean vector,
+		       GError **error)
+{
+  cairo_surface_t *pdf_surface;
+  cairo_status_t status;
+  cairo_t *cr;
+  gint d_width, d_height;
+  gboolean ret = TRUE;
+  guint n_raster = 0;
+  GTimer *timer;
+  guint i;
+  
+  if (!vector && !cogl_features_available (COGL_FEATURE_OFFSCREEN))
+    {
+      g_set_error (error, GLIDE_EXPORT_ERROR, GLIDE_EXPORT_ERROR_UNSUPPORTED,
+		   "Offscreen rendering is not supported");
+      return FALSE;
+    }
+  
+  glide_document_get_size (document, &d_width, &d_height);
+  if (width <= 0 || height <= 0)
+    {
+      width = d_width;
+      height = d_height;
+    }
+  
+  timer = g_timer_new ();
+  
+  // Pages keep the size of the document, rasters are scaled to fit.
+  pdf_surface = cairo_pdf_surface_create (filename, d_width, d_height);
+  cr = cairo_create (pdf_surface);
+  
+  for (i = 0; i < glide_document_get_n_slides (document); i++)
+    {
+      GlideSlide *slide = glide_document_get_nth_slide (document, i);
+      cairo_surface_t *surface;
+      
+      if (vector && glide_cairo_util_draw_slide (cr, slide))
+	{
+	  cairo_show_page (cr);
+	  continue;
+	}
+      
+      surface = glide_export_render_slide (slide, width, height);
+      if (!surface)
+	{
+	  g_set_error (error, GLIDE_EXPORT_ERROR, GLIDE_EXPORT_ERROR_UNSUPPORTED,
+		       "Failed to render slide %u offscreen", i + 1);
+	  ret = FALSE;
+	  break;
+	}
+      n_raster++;
+      
+      cairo_save (cr);
+      cairo_scale (cr, (gdouble) d_width / width, (gdouble) d_height / height);
+      cairo_set_source_surface (cr, surface, 0, 0);
+      cairo_paint (cr);
+      cairo_restore (cr);
+      
+      cairo_show_page (cr);
+      
+      cairo_surface_destroy (surface);
+    }
+  
+  cairo_destroy (cr);
+  cairo_surface_finish (pdf_surface);
+  
+  status = cairo_surface_status (pdf_surface);
+  if (ret && status != CAIRO_STATUS_SUCCESS)
+    {
+      g_set_error (error, GLIDE_EXPORT_ERROR, GLIDE_EXPORT_ERROR_FAILED,
+		   "Failed to write %s: %s", filename, cairo_status_to_string (status));
+      ret = FALSE;
+    }
+  cairo_surface_destroy (pdf_surface);
+  
+  GLIDE_NOTE (MISC, "Exported %u slides (%u rasterized at %dx%d) to %s in %f seconds",
+	      i, n_raster, width, height, filename, g_timer_elapsed (timer, NULL));
+  g_timer_destroy (timer);
+  
+  return ret;
+}
+
+/*
+ * Exports every slide of document as one page of a PDF, rendered at
+ * width by height pixels. Passing 0 for either uses the size of the
+ * document. Nothing is drawn to the screen, and the current slide is
+ * left alone.
+ */
+gboolean
+glide_export_pdf (GlideDocument *document,
+		  const gchar *filename,
+		  gint width,
+		  gint height,
+		  GError **error)
+{
+  return glide_export_pdf_real (document, filename, width, height, FALSE, error);
+}
+
+/*
+ * As above, but slides are drawn as vectors: text stays selectable
+ * and JPEG images are embedded as they are. Slides holding anything
+ * glide_cairo_util_draw_slide can't draw are rasterized.
+ */
+gboolean
+glide_export_pdf_vector (GlideDocument *document,
+			 const gchar *filename,
+			 GError **error)
+{
+  return glide_export_pdf_real (document, filename, 0, 0, TRUE, error);
+}
+
+typedef struct _GlideExportImages {
+  GMutex *lock;
+  GCond *cond;
+  
+  guint in_flight;
+  GError *error;
+} GlideExportImages;
+
+typedef struct _GlideExportImageJob {
+  GlideExportImages *state;
+  
+  cairo_surface_t *surface;
+  GlideExportFormat format;
+  gchar *path;
+} GlideExportImageJob;
+
+/* Runs on the encoder threads, the surface is ours alone by now */
+static void
+glide_export_encode_func (gpointer data, gpointer user_data)
+{
+  GlideExportImageJob *job = (GlideExportImageJob *)data;
+  GlideExportImages *state = job->state;
+  cairo_status_t status;
+  GError *e = NULL;
+  
+  if (job->format == GLIDE_EXPORT_FORMAT_JPEG)
+    {
+      GdkPixbuf *pixbuf = glide_cairo_util_surface_to_pixbuf (job->surface);
+      
+      gdk_pixbuf_save (pixbuf, job->path, "jpeg", &e, "quality", "90", NULL);
+      g_object_unref (pixbuf);
+    }
+  else if ((status = cairo_surface_write_to_png (job->surface, job->path)) != CAIRO_STATUS_SUCCESS)
+    {
+      g_set_error (&e, GLIDE_EXPORT_ERROR, GLIDE_EXPORT_ERROR_FAILED,
+		   "Failed to write %s: %s", job->path, cairo_status_to_string (status));
+    }
+  
+  g_mutex_lock (state->lock);
+  if (e && !state->error)
+    state->error = e;
+  else if (e)
+    g_error_free (e);
+  state->in_flight--;
+  g_cond_signal (state->cond);
+  g_mutex_unlock (state->lock);
+  
+  cairo_surface_destroy (job->surface);
+  g_free (job->path);
+  g_slice_free (GlideExportImageJob, job);
+}
+
+/*
+ * Draws the slide with cairo where it can, which needs no GL and
+ * is safe without a visible stage, or offscreen otherwise.
+ */
+cairo_surface_t *
+glide_export_draw_slide (GlideSlide *slide, gint width, gint height)
+{
+  cairo_surface_t *surface, *raster;
+  gfloat s_width, s_height;
+  cairo_t *cr;
+  
+  // A slide which was never allocated is drawn at the document size.
+  clutter_actor_get_size (CLUTTER_ACTOR (slide), &s_width, &s_height);
+  if (s_width <= 0 || s_height <= 0)
+    {
+      GlideDocument *document = NULL;
+      gint d_width = 0, d_height = 0;
+      
+      g_object_get (slide, "document", &document, NULL);
+      if (document)
+	{
+	  glide_document_get_size (document, &d_width, &d_height);
+	  g_object_unref (document);
+	}
+      if (d_width <= 0 || d_height <= 0)
+	return NULL;
+      
+      s_width = d_width;
+      s_height = d_height;
+    }
+  
+  surface = cairo_image_surface_create (CAIRO_FORMAT_RGB24, width, height);
+  cr = cairo_create (surface);
+  
+  cairo_scale (cr, width / s_width, height / s_height);
+  
+  if (!glide_cairo_util_draw_slide (cr, slide))
+    {
+      if (!(raster = glide_export_render_slide (slide, width, height)))
+	{
+	  cairo_destroy (cr);
+	  cairo_surface_destroy (surface);
+	  
+	  return NULL;
+	}
+      cairo_identity_matrix (cr);
+      cairo_set_source_surface (cr, raster, 0, 0);
+      cairo_paint (cr);
+      
+      cairo_surface_destroy (raster);
+    }
+  cairo_destroy (cr);
+  
+  return surface;
+}
+
+static JsonNode *
+glide_export_manifest_new (gint width, gint height, GlideExportFormat format)
+{
+  JsonNode *node = json_node_new (JSON_NODE_OBJECT);
+  JsonObject *obj = json_object_new ();
+  
+  json_node_take_object (node, obj);
+  json_object_set_int_member (obj, "width", width);
+  json_object_set_int_member (obj, "height", height);
+  json_object_set_string_member (obj, "format",
+				 format == GLIDE_EXPORT_FORMAT_JPEG ? "jpeg" : "png");
+  json_object_set_array_member (obj, "slides", json_array_new ());
+  
+  return node;
+}
+
+/* Maps file names to slide checksums, for an export of the same kind */
+static GHashTable *
+glide_export_manifest_load (const gchar *path, JsonNode *current)
+{
+  JsonObject *obj, *c_obj = json_node_get_object (current);
+  JsonParser *parser = json_parser_new ();
+  GHashTable *hashes = NULL;
+  JsonArray *slides;
+  guint i;
+  
+  if (!json_parser_load_from_file (parser, path, NULL) ||
+      !JSON_NODE_HOLDS_OBJECT (json_parser_get_root (parser)))
+    goto out;
+  
+  obj = json_node_get_object (json_parser_get_root (parser));
+  if (!json_object_has_member (obj, "slides") ||
+      json_object_get_int_member (obj, "width") != json_object_get_int_member (c_obj, "width") ||
+      json_object_get_int_member (obj, "height") != json_object_get_int_member (c_obj, "height") ||
+      g_strcmp0 (json_object_get_string_member (obj, "format"),
+		 json_object_get_string_member (c_obj, "format")))
+    goto out;
+  
+  hashes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  
+  slides = json_object_get_array_member (obj, "slides");
+  for (i = 0; i < json_array_get_length (slides); i++)
+    {
+      JsonObject *s = json_array_get_object_element (slides, i);
+      
+      g_hash_table_insert (hashes,
+			   g_strdup (json_object_get_string_member (s, "file")),
+			   g_strdup (json_object_get_string_member (s, "checksum")));
+    }
+  
+ out:
+  g_object_unref (parser);
+  
+  return hashes;
+}
+
+/*
+ * Renders every slide of document to an image in directory, at width
+ * by height or the document size. Drawing stays on this thread as it
+ * touches actors, while n_jobs threads encode and write the files.
+ * With reuse set, slides whose checksum matches the manifest of the
+ * last export to directory keep their old image.
+ */
+gboolean
+glide_export_images (GlideDocument *document,
+		     const gchar *directory,
+		     gint width,
+		     gint height,
+		     GlideExportFormat format,
+		     guint n_jobs,
+		     gboolean reuse,
+		     GError **error)
+{
+  GlideExportImages state = { 0, };
+  GThreadPool *pool;
+  GHashTable *old_hashes = NULL;
+  JsonGenerator *gen;
+  JsonNode *manifest;
+  JsonArray *slides;
+  gchar *manifest_path;
+  guint i, n_slides, n_reused = 0;
+  GTimer *timer;
+  
+  if (g_mkdir_with_parents (directory, 0755) < 0)
+    {
+      g_set_error (error, GLIDE_EXPORT_ERROR, GLIDE_EXPORT_ERROR_FAILED,
+		   "Failed to create %s: %s", directory, g_strerror (errno));
+      return FALSE;
+    }
+  
+  if (width <= 0 || height <= 0)
+    glide_document_get_size (document, &width, &height);
+  n_jobs = MAX (n_jobs, 1);
+  
+  timer = g_timer_new ();
+  
+  manifest = glide_export_manifest_new (width, height, format);
+  slides = json_object_get_array_member (json_node_get_object (manifest), "slides");
+  manifest_path = g_build_filename (directory, "manifest.json", NULL);
+  if (reuse)
+    old_hashes = glide_export_manifest_load (manifest_path, manifest);
+  
+  state.lock = g_mutex_new ();
+  state.cond = g_cond_new ();
+  pool = g_thread_pool_new (glide_export_encode_func, NULL, n_jobs, TRUE, NULL);
+  
+  n_slides = glide_document_get_n_slides (document);
+  for (i = 0; i < n_slides; i++)
+    {
+      GlideSlide *slide = glide_document_get_nth_slide (document, i);
+      GlideExportImageJob *job;
+      cairo_surface_t *surface;
+      JsonObject *entry;
+      gchar *checksum, *name, *path;
+      gboolean failed;
+      
+      name = g_strdup_printf ("slide-%04u.%s", i + 1,
+			      format == GLIDE_EXPORT_FORMAT_JPEG ? "jpg" : "png");
+      path = g_build_filename (directory, name, NULL);
+      checksum = glide_slide_get_checksum (slide);
+      
+      entry = json_object_new ();
+      json_object_set_string_member (entry, "file", name);
+      json_object_set_string_member (entry, "checksum", checksum);
+      json_array_add_object_element (slides, entry);
+      
+      if (old_hashes && !g_strcmp0 (g_hash_table_lookup (old_hashes, name), checksum) &&
+	  g_file_test (path, G_FILE_TEST_EXISTS))
+	{
+	  n_reused++;
+	  g_free (name);
+	  g_free (path);
+	  g_free (checksum);
+	  continue;
+	}
+      g_free (name);
+      g_free (checksum);
+      
+      surface = glide_export_draw_slide (slide, width, height);
+      
+      // Keep only a few finished slides waiting for the encoders.
+      g_mutex_lock (state.lock);
+      while (state.in_flight >= 2 * n_jobs)
+	g_cond_wait (state.cond, state.lock);
+      if (!surface && !state.error)
+	g_set_error (&state.error, GLIDE_EXPORT_ERROR, GLIDE_EXPORT_ERROR_UNSUPPORTED,
+		     "Failed to render slide %u", i + 1);
+      failed = state.error != NULL;
+      if (!failed)
+	state.in_flight++;
+      g_mutex_unlock (state.lock);
+      
+      if (failed)
+	{
+	  if (surface)
+	    cairo_surface_destroy (surface);
+	  g_free (path);
+	  break;
+	}
+      
+      job = g_slice_new (GlideExportImageJob);
+      job->state = &state;
+      job->surface = surface;
+      job->format = format;
+      job->path = path;
+      
+      g_thread_pool_push (pool, job, NULL);
+    }
+  
+  // Waits for the queued jobs to finish.
+  g_thread_pool_free (pool, FALSE, TRUE);
+  
+  if (!state.error)
+    {
+      gen = json_generator_new ();
+      g_object_set (gen, "pretty", TRUE, NULL);
+      json_generator_set_root (gen, manifest);
+      json_generator_to_file (gen, manifest_path, &state.error);
+      g_object_unref (gen);
+    }
+  
+  GLIDE_NOTE (MISC, "Exported %u slides (%u reused) at %dx%d to %s with %u jobs in %f seconds",
+	      i, n_reused, width, height, directory, n_jobs, g_timer_elapsed (timer, NULL));
+  
+  g_timer_destroy (timer);
+  json_node_free (manifest);
+  g_free (manifest_path);
+  if (old_hashes)
+    g_hash_table_destroy (old_hashes);
+  g_mutex_free (state.lock);
+  g_cond_free (state.cond);
+  
+  if (state.error)
+    {
+      g_propagate_error (error, state.error);
+      return FALSE;
+    }
+  
+  return TRUE;
+}
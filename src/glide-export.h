@@ -0,0 +1,62 @@
+/*
+ * glide-export.h
+ * This file is part of glide
+ *
+ * Copyright (C) 2010 - Robert Carr
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, 
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GLIDE_EXPORT_H__
+#define __GLIDE_EXPORT_H__
+
+#include <cairo.h>
+
+#include "glide-document.h"
+#include "glide-slide.h"
+
+G_BEGIN_DECLS
+
+#define GLIDE_EXPORT_ERROR (glide_export_error_quark ())
+
+typedef enum
+{
+  GLIDE_EXPORT_ERROR_UNSUPPORTED,
+  GLIDE_EXPORT_ERROR_FAILED
+} GlideExportError;
+
+typedef enum
+{
+  GLIDE_EXPORT_FORMAT_PNG,
+  GLIDE_EXPORT_FORMAT_JPEG
+} GlideExportFormat;
+
+GQuark glide_export_error_quark (void);
+
+gboolean glide_export_pdf (GlideDocument *document, const gchar *filename,
+			   gint width, gint height, GError **error);
+gboolean glide_export_pdf_vector (GlideDocument *document, const gchar *filename,
+				  GError **error);
+
+cairo_surface_t *glide_export_draw_slide (GlideSlide *slide, gint width, gint height);
+
+gboolean glide_export_images (GlideDocument *document, const gchar *directory,
+			      gint width, gint height, GlideExportFormat format,
+			      guint n_jobs, gboolean reuse, GError **error);
+
+G_END_DECLS
+
+#endif
@@ -42,6 +42,15 @@ struct _GlideImagePrivate
   gchar *filename;
 
   gboolean motion_since_press;
+  
+  /* Cleared while an asynchronous load is pending, see glide_image_paint */
+  gboolean has_texture;
+  guint load_generation;
+  
+  /* Downscale factor of the uploaded texture, 0 if none is */
+  guint tier;
+  guint pending_tier;
+  gsize texture_bytes;
 };
 
 G_END_DECLS
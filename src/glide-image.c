@@ -20,10 +20,16 @@
  * Boston, MA 02111-1307, USA.
  */
 
+#include <string.h>
+#include <unistd.h>
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
 #include "glide-image.h"
 #include "glide-image-priv.h"
 
 #include "glide-json-util.h"
+#include "glide-texture-cache.h"
 
 #include "glide-debug.h"
 
@@ -38,6 +44,24 @@ enum
 
 #define GLIDE_IMAGE_GET_PRIVATE(object)(G_TYPE_INSTANCE_GET_PRIVATE ((object), GLIDE_TYPE_IMAGE, GlideImagePrivate))
 
+#define GLIDE_IMAGE_MAX_TIER 8
+
+typedef struct _GlideImageDecodeJob {
+  GlideImage *image;
+  guint generation;
+  
+  gchar *filename;
+  guint scale;
+  gint width, height;
+  
+  GdkPixbuf *pixbuf;
+  GError *error;
+} GlideImageDecodeJob;
+
+static GThreadPool *decode_pool = NULL;
+
+static void glide_image_update_tier (GlideImage *image);
+
 static void
 glide_image_paint (ClutterActor *self)
 {
@@ -56,9 +80,19 @@ glide_image_paint (ClutterActor *self)
 	      "painting image '%s'",
 	      GLIDE_ACTOR_DISPLAY_NAME (self));
   
-  cogl_material_set_color4ub (priv->material, paint_opacity, paint_opacity, paint_opacity, paint_opacity);
   clutter_actor_get_allocation_box (self, &box);
   
+  // Placeholder until the asynchronous load finishes.
+  if (!priv->has_texture)
+    {
+      cogl_set_source_color4ub (0xcc, 0xcc, 0xcc, paint_opacity);
+      cogl_rectangle (0, 0, box.x2 - box.x1, box.y2 - box.y1);
+      
+      return;
+    }
+  
+  cogl_material_set_color4ub (priv->material, paint_opacity, paint_opacity, paint_opacity, paint_opacity);
+  
   GLIDE_NOTE (PAINT, "paint to x1: %f, y1: %f x2: %f, y2: %f "
 	      "opacity: %i",
 	      box.x1, box.y1, box.x2, box.y2,
@@ -101,11 +135,22 @@ glide_image_get_preferred_height (ClutterActor *self,
   *natural_height_p = image->priv->image_height;
 }
 
+static void
+glide_image_allocate (ClutterActor *self,
+		      const ClutterActorBox *box,
+		      ClutterAllocationFlags flags)
+{
+  CLUTTER_ACTOR_CLASS (glide_image_parent_class)->allocate (self, box, flags);
+  
+  glide_image_update_tier (GLIDE_IMAGE (self));
+}
+
 static void
 image_free_gl_resources (GlideImage *image)
 {
   if (image->priv->material != COGL_INVALID_HANDLE)
     cogl_material_set_layer (image->priv->material, 0, COGL_INVALID_HANDLE);
+  image->priv->texture_bytes = 0;
 }
 
 static gboolean
@@ -261,8 +306,10 @@ glide_image_deserialize (GlideActor *actor, JsonObject *actor_obj)
   }
   
   filename = glide_json_object_get_string (image_props, "filename");
-  // TODO: Error checking
-  glide_image_set_from_file (image, filename, NULL);
+  
+  if (image->priv->filename && filename && !strcmp (filename, image->priv->filename))
+    return;
+  glide_image_set_from_file_async (image, filename);
 }
 
 static void
@@ -280,6 +327,7 @@ glide_image_class_init (GlideImageClass *klass)
   
   actor_class->get_preferred_width = glide_image_get_preferred_width;
   actor_class->get_preferred_height = glide_image_get_preferred_height;
+  actor_class->allocate = glide_image_allocate;
   
   glide_actor_class->serialize = glide_image_serialize;
   glide_actor_class->deserialize = glide_image_deserialize;
@@ -317,25 +365,43 @@ glide_image_new ()
 		       NULL);
 }
 
-void
-glide_image_set_cogl_texture (GlideImage *image,
-			      CoglHandle new_texture)
+static void
+glide_image_set_texture_real (GlideImage *image,
+			      CoglHandle new_texture,
+			      guint tier)
 {
-  guint width, height;
-  
-  width = cogl_texture_get_width (new_texture);
-  height = cogl_texture_get_height (new_texture);
+  GlideImagePrivate *priv = image->priv;
+  gsize old_bytes = priv->texture_bytes;
   
   cogl_handle_ref (new_texture);
   
   image_free_gl_resources (image);
   
-  cogl_material_set_layer (image->priv->material, 0, new_texture);
+  cogl_material_set_layer (priv->material, 0, new_texture);
+  
+  priv->has_texture = TRUE;
+  priv->tier = tier;
+  priv->texture_bytes = cogl_texture_get_width (new_texture) * 
+    cogl_texture_get_height (new_texture) * 4;
   
-  image->priv->image_width = width;
-  image->priv->image_height = height;
+  GLIDE_NOTE (IMAGE, "Image '%s' at 1/%u scale, texture memory %lu -> %lu bytes",
+	      GLIDE_ACTOR_DISPLAY_NAME (CLUTTER_ACTOR (image)), tier,
+	      (gulong) old_bytes, (gulong) priv->texture_bytes);
   
   cogl_handle_unref (new_texture);
+  
+  clutter_actor_queue_redraw (CLUTTER_ACTOR (image));
+}
+
+void
+glide_image_set_cogl_texture (GlideImage *image,
+			      CoglHandle new_texture)
+{
+  image->priv->image_width = cogl_texture_get_width (new_texture);
+  image->priv->image_height = cogl_texture_get_height (new_texture);
+  image->priv->pending_tier = 0;
+  
+  glide_image_set_texture_real (image, new_texture, 1);
 }
 
 gboolean
@@ -346,24 +412,15 @@ glide_image_set_from_file (GlideImage *image,
   GlideImagePrivate *priv;
   CoglHandle new_texture = COGL_INVALID_HANDLE;
   GError *internal_error = NULL;
-  CoglTextureFlags flags = COGL_TEXTURE_NONE;
   
   priv = image->priv;
   if (priv->filename)
     g_free (priv->filename);
   priv->filename = g_strdup (filename);
+  priv->load_generation++;
   
-  new_texture = cogl_texture_new_from_file (filename,
-					    flags,
-					    COGL_PIXEL_FORMAT_ANY,
-					    &internal_error);
+  new_texture = glide_texture_cache_get_texture (filename, &internal_error);
   
-  if (internal_error == NULL && new_texture == COGL_INVALID_HANDLE)
-    {
-      g_set_error (&internal_error, CLUTTER_TEXTURE_ERROR,
-		   CLUTTER_TEXTURE_ERROR_BAD_FORMAT,
-		   "Failed to create COGL texture");
-    }
   if (internal_error != NULL)
     {
       g_propagate_error (error, internal_error);
@@ -378,6 +435,206 @@ glide_image_set_from_file (GlideImage *image,
   return TRUE;
 }
 
+static void
+glide_image_decode_job_free (GlideImageDecodeJob *job)
+{
+  g_object_unref (job->image);
+  g_free (job->filename);
+  
+  if (job->pixbuf)
+    g_object_unref (job->pixbuf);
+  if (job->error)
+    g_error_free (job->error);
+  
+  g_slice_free (GlideImageDecodeJob, job);
+}
+
+static CoglHandle
+glide_image_texture_from_pixbuf (GdkPixbuf *pixbuf)
+{
+  return cogl_texture_new_from_data (gdk_pixbuf_get_width (pixbuf),
+				     gdk_pixbuf_get_height (pixbuf),
+				     COGL_TEXTURE_NONE,
+				     gdk_pixbuf_get_has_alpha (pixbuf) ?
+				     COGL_PIXEL_FORMAT_RGBA_8888 : COGL_PIXEL_FORMAT_RGB_888,
+				     COGL_PIXEL_FORMAT_ANY,
+				     gdk_pixbuf_get_rowstride (pixbuf),
+				     gdk_pixbuf_get_pixels (pixbuf));
+}
+
+/* Back on the main loop, GL is only touched here */
+static gboolean
+glide_image_decode_done (gpointer user_data)
+{
+  GlideImageDecodeJob *job = (GlideImageDecodeJob *)user_data;
+  GlideImage *image = job->image;
+  CoglHandle texture;
+  
+  if (job->generation != image->priv->load_generation)
+    {
+      GLIDE_NOTE (IMAGE, "Dropping stale decode of %s", job->filename);
+      goto out;
+    }
+  
+  if (job->scale == image->priv->pending_tier)
+    image->priv->pending_tier = 0;
+  
+  if (job->error)
+    {
+      g_warning ("Failed to load image %s: %s", job->filename, job->error->message);
+    }
+  else if (image->priv->tier && image->priv->tier <= job->scale)
+    {
+      GLIDE_NOTE (IMAGE, "Dropping 1/%u decode of %s, a sharper tier is loaded", 
+		  job->scale, job->filename);
+    }
+  else
+    {
+      texture = glide_image_texture_from_pixbuf (job->pixbuf);
+      if (texture != COGL_INVALID_HANDLE)
+	{
+	  glide_texture_cache_insert_texture (job->filename, job->scale, texture);
+	  glide_image_set_texture_real (image, texture, job->scale);
+	  cogl_handle_unref (texture);
+	}
+    }
+  
+ out:
+  
+  glide_image_decode_job_free (job);
+  
+  return FALSE;
+}
+
+static void
+glide_image_decode_func (gpointer data, gpointer user_data)
+{
+  GlideImageDecodeJob *job = (GlideImageDecodeJob *)data;
+  
+  if (job->scale > 1)
+    job->pixbuf = gdk_pixbuf_new_from_file_at_scale (job->filename, job->width, job->height,
+						     FALSE, &job->error);
+  else
+    job->pixbuf = gdk_pixbuf_new_from_file (job->filename, &job->error);
+  
+  g_idle_add (glide_image_decode_done, job);
+}
+
+static GThreadPool *
+glide_image_get_decode_pool (void)
+{
+  if (!decode_pool)
+    {
+      glong n_cpus = sysconf (_SC_NPROCESSORS_ONLN);
+      
+      decode_pool = g_thread_pool_new (glide_image_decode_func, NULL,
+				       MAX (n_cpus, 1), FALSE, NULL);
+    }
+  return decode_pool;
+}
+
+static void
+glide_image_request_tier (GlideImage *image, guint tier)
+{
+  GlideImagePrivate *priv = image->priv;
+  GlideImageDecodeJob *job;
+  CoglHandle texture;
+  
+  // Only ever move to a sharper tier.
+  if (priv->tier && priv->tier <= tier)
+    return;
+  if (priv->pending_tier && priv->pending_tier <= tier)
+    return;
+  
+  texture = glide_texture_cache_lookup_texture (priv->filename, tier);
+  if (texture != COGL_INVALID_HANDLE)
+    {
+      glide_image_set_texture_real (image, texture, tier);
+      cogl_handle_unref (texture);
+      
+      return;
+    }
+  
+  job = g_slice_new0 (GlideImageDecodeJob);
+  job->image = g_object_ref (image);
+  job->generation = priv->load_generation;
+  job->filename = g_strdup (priv->filename);
+  job->scale = tier;
+  job->width = MAX (priv->image_width / tier, 1);
+  job->height = MAX (priv->image_height / tier, 1);
+  
+  priv->pending_tier = tier;
+  
+  GLIDE_NOTE (IMAGE, "Queueing 1/%u decode of %s", tier, priv->filename);
+  
+  g_thread_pool_push (glide_image_get_decode_pool (), job, NULL);
+}
+
+/*
+ * Picks the smallest power of two downscale which still covers the
+ * size the image is drawn at, including the stage scale.
+ */
+static void
+glide_image_update_tier (GlideImage *image)
+{
+  GlideImagePrivate *priv = image->priv;
+  gfloat width, height;
+  guint tier;
+  
+  if (!priv->filename || !priv->image_width || !priv->image_height)
+    return;
+  
+  clutter_actor_get_transformed_size (CLUTTER_ACTOR (image), &width, &height);
+  if (width <= 0 || height <= 0)
+    return;
+  
+  for (tier = GLIDE_IMAGE_MAX_TIER; tier > 1; tier /= 2)
+    if (priv->image_width / tier >= width && priv->image_height / tier >= height)
+      break;
+  
+  glide_image_request_tier (image, tier);
+}
+
+/*
+ * Decodes on a worker thread and uploads from the main loop. Until
+ * then the image paints a placeholder at the size of the file. The
+ * texture is decoded at a resolution matching the allocation, see
+ * glide_image_update_tier.
+ */
+void
+glide_image_set_from_file_async (GlideImage *image,
+				 const gchar *filename)
+{
+  GlideImagePrivate *priv = image->priv;
+  gint width, height;
+  
+  if (priv->filename)
+    g_free (priv->filename);
+  priv->filename = g_strdup (filename);
+  priv->load_generation++;
+  
+  image_free_gl_resources (image);
+  priv->has_texture = FALSE;
+  priv->tier = 0;
+  priv->pending_tier = 0;
+  
+  if (!filename)
+    return;
+  
+  if (gdk_pixbuf_get_file_info (filename, &width, &height))
+    {
+      priv->image_width = width;
+      priv->image_height = height;
+      
+      // The tier is picked once we are allocated.
+      clutter_actor_queue_relayout (CLUTTER_ACTOR (image));
+    }
+  else
+    {
+      glide_image_request_tier (image, 1);
+    }
+}
+
 ClutterActor *
 glide_image_new_from_file (const gchar *filename, 
 			   GError **error)
@@ -404,3 +661,47 @@ glide_image_get_filename (GlideImage *image)
 {
   return image->priv->filename;
 }
+
+gsize
+glide_image_get_texture_memory (GlideImage *image)
+{
+  return image->priv->texture_bytes;
+}
+
+/* Starts loading the texture for the current size, if it isn't yet */
+void
+glide_image_prepare (GlideImage *image)
+{
+  ClutterActorBox box;
+  
+  clutter_actor_get_allocation_box (CLUTTER_ACTOR (image), &box);
+  glide_image_update_tier (image);
+}
+
+/* 
+ * Loads the full resolution texture synchronously, for rendering
+ * outside of the main loop such as export.
+ */
+gboolean
+glide_image_ensure_texture (GlideImage *image, GError **error)
+{
+  GlideImagePrivate *priv = image->priv;
+  CoglHandle texture;
+  
+  if (!priv->filename)
+    return FALSE;
+  if (priv->has_texture && priv->tier == 1)
+    return TRUE;
+  
+  texture = glide_texture_cache_get_texture (priv->filename, error);
+  if (texture == COGL_INVALID_HANDLE)
+    return FALSE;
+  
+  // Any decode still in flight is dropped once it arrives.
+  priv->pending_tier = 0;
+  glide_image_set_texture_real (image, texture, 1);
+  
+  cogl_handle_unref (texture);
+  
+  return TRUE;
+}
@@ -60,10 +60,16 @@ ClutterActor *glide_image_new              ();
 ClutterActor *glide_image_new_from_file    (const gchar *filename, GError **error);
 
 gboolean glide_image_set_from_file         (GlideImage *image, const gchar *filename, GError **error);
+void glide_image_set_from_file_async       (GlideImage *image, const gchar *filename);
 void glide_image_set_cogl_texture          (GlideImage *image, CoglHandle new_texture);
 
 const gchar *glide_image_get_filename (GlideImage *image);
 
+gsize glide_image_get_texture_memory (GlideImage *image);
+
+void glide_image_prepare (GlideImage *image);
+gboolean glide_image_ensure_texture (GlideImage *image, GError **error);
+
 G_END_DECLS
 
 #endif /* __CLUTTER_IMAGE_H__ */
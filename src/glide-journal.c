@@ -0,0 +1,825 @@
+/*
+ * glide-journal.c
+ * This file is part of glide
+ *
+ * Copyright (C) 2010 - Robert Carr
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <glib/gstdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "glide-journal.h"
+
+#include "glide-slide.h"
+#include "glide-json-util.h"
+
+#include "glide-debug.h"
+
+#define FLUSH_INTERVAL_MSEC 1000
+
+/*
+ * Changes to a document are appended to a journal next to it, one line
+ * of JSON each, so the work since the last save survives a crash:
+ *
+ *   {"op":"slide","slide":3,"action":"undo","label":"Move object","data":{...}}
+ *   {"op":"insert-slide","slide":4,"data":{...}}
+ *   {"op":"remove-slide","slide":4}
+ *   {"op":"resize","width":1024,"height":768}
+ *
+ * A slide record holds the whole slide rather than the undo entry, so
+ * replaying is idempotent and doesn't depend on actors being found by
+ * their stacking order. Thanks to the slides keeping their JSON, only
+ * the changed slide is serialized. Records are made for edits, that is
+ * undo manager operations, glide_journal_slide_edited and changes to
+ * the slides of the document; a slide which changes outside of an
+ * edit is written with the next one. The main thread builds the
+ * records and turns them into text right away, as they share JSON
+ * with the slides, a thread writes and syncs the text every
+ * FLUSH_INTERVAL_MSEC.
+ */
+
+typedef struct _GlideJournalRecord {
+  guint seq;
+  gchar *line;
+} GlideJournalRecord;
+
+struct _GlideJournal {
+  GlideDocument *document;
+  GlideUndoManager *undo_manager;
+  gchar *document_path;
+  gchar *path;
+
+  /* The slides of the document as of the last record */
+  GPtrArray *slides;
+  GHashTable *changed;
+  guint record_id;
+
+  gboolean resizing;
+  guint resize_id;
+
+  /* The undo manager operation behind the next records */
+  const gchar *action;
+  gchar *label;
+
+  guint next_seq;
+  GQueue checkpoints;
+  /* Records made since the oldest save in progress started */
+  GQueue retained;
+
+  GThread *thread;
+  GMutex *lock;
+  GCond *cond;
+
+  /* Protected by lock */
+  GQueue pending;
+  gboolean truncate;
+  gboolean quit;
+
+  gint fd;
+};
+
+gchar *
+glide_journal_get_path (const gchar *document_path)
+{
+  gchar *dir = g_path_get_dirname (document_path);
+  gchar *base = g_path_get_basename (document_path);
+  gchar *name = g_strdup_printf (".%s.journal", base);
+  gchar *path = g_build_filename (dir, name, NULL);
+
+  g_free (dir);
+  g_free (base);
+  g_free (name);
+
+  return path;
+}
+
+static gint
+glide_journal_open (const gchar *path, gboolean keep, GError **error)
+{
+  gint fd = g_open (path, O_WRONLY | O_CREAT | O_APPEND | (keep ? 0 : O_TRUNC), 0600);
+
+  if (fd < 0)
+    {
+      gint save_errno = errno;
+
+      g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (save_errno),
+		   "Failed to open journal '%s': %s", path, g_strerror (save_errno));
+    }
+
+  return fd;
+}
+
+static void
+glide_journal_write (GlideJournal *journal, const gchar *data, gsize length)
+{
+  while (length > 0)
+    {
+      gssize written = write (journal->fd, data, length);
+
+      if (written < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  g_warning ("Failed to write journal %s: %s", journal->path, g_strerror (errno));
+	  break;
+	}
+      data += written;
+      length -= written;
+    }
+  fsync (journal->fd);
+}
+
+static void
+glide_journal_write_records (GlideJournal *journal, GList *records)
+{
+  GString *buffer = g_string_new (NULL);
+  GList *r;
+
+  for (r = records; r; r = r->next)
+    {
+      g_string_append (buffer, (gchar *)r->data);
+      g_free (r->data);
+    }
+
+  glide_journal_write (journal, buffer->str, buffer->len);
+
+  g_string_free (buffer, TRUE);
+}
+
+static gpointer
+glide_journal_flush_func (gpointer data)
+{
+  GlideJournal *journal = (GlideJournal *)data;
+  gboolean quit = FALSE;
+
+  g_mutex_lock (journal->lock);
+  while (!quit)
+    {
+      GList *records;
+      gboolean truncate;
+
+      if (!journal->quit && !journal->truncate)
+	{
+	  GTimeVal until;
+
+	  g_get_current_time (&until);
+	  g_time_val_add (&until, FLUSH_INTERVAL_MSEC * 1000);
+	  g_cond_timed_wait (journal->cond, journal->lock, &until);
+	}
+
+      quit = journal->quit;
+      truncate = journal->truncate;
+      journal->truncate = FALSE;
+      records = journal->pending.head;
+      g_queue_init (&journal->pending);
+      g_mutex_unlock (journal->lock);
+
+      // Opened for appending, so writes follow the truncation.
+      if (truncate && ftruncate (journal->fd, 0) != 0)
+	g_warning ("Failed to truncate journal %s: %s", journal->path, g_strerror (errno));
+      if (records || truncate)
+	glide_journal_write_records (journal, records);
+      g_list_free (records);
+
+      g_mutex_lock (journal->lock);
+    }
+  g_mutex_unlock (journal->lock);
+
+  return NULL;
+}
+
+/* Returns once everything pushed so far is written */
+static void
+glide_journal_stop_thread (GlideJournal *journal)
+{
+  g_mutex_lock (journal->lock);
+  journal->quit = TRUE;
+  g_cond_signal (journal->cond);
+  g_mutex_unlock (journal->lock);
+
+  g_thread_join (journal->thread);
+  journal->thread = NULL;
+  journal->quit = FALSE;
+}
+
+static void
+glide_journal_push (GlideJournal *journal, JsonObject *obj)
+{
+  JsonGenerator *gen = json_generator_new ();
+  JsonNode *node = json_node_new (JSON_NODE_OBJECT);
+  gchar *data, *line;
+
+  json_node_take_object (node, obj);
+  json_generator_set_root (gen, node);
+  data = json_generator_to_data (gen, NULL);
+  line = g_strconcat (data, "\n", NULL);
+
+  g_free (data);
+  json_node_free (node);
+  g_object_unref (gen);
+
+  if (journal->checkpoints.length)
+    {
+      GlideJournalRecord *record = g_slice_new (GlideJournalRecord);
+
+      record->seq = journal->next_seq;
+      record->line = g_strdup (line);
+      g_queue_push_tail (&journal->retained, record);
+    }
+  journal->next_seq++;
+
+  g_mutex_lock (journal->lock);
+  g_queue_push_tail (&journal->pending, line);
+  g_mutex_unlock (journal->lock);
+}
+
+static JsonObject *
+glide_journal_record_new (const gchar *op, gint slide)
+{
+  JsonObject *obj = json_object_new ();
+
+  json_object_set_string_member (obj, "op", op);
+  if (slide >= 0)
+    json_object_set_int_member (obj, "slide", slide);
+
+  return obj;
+}
+
+static void
+glide_journal_record_slide (GlideJournal *journal, const gchar *op, GlideSlide *slide, gint index)
+{
+  JsonObject *obj = glide_journal_record_new (op, index);
+
+  if (journal->action)
+    {
+      json_object_set_string_member (obj, "action", journal->action);
+      if (journal->label)
+	json_object_set_string_member (obj, "label", journal->label);
+    }
+  json_object_set_member (obj, "data", glide_actor_serialize (GLIDE_ACTOR (slide)));
+
+  glide_journal_push (journal, obj);
+}
+
+/* Writes out the slides changed since the last record */
+static void
+glide_journal_record_changed (GlideJournal *journal)
+{
+  guint i;
+
+  if (journal->record_id)
+    {
+      g_source_remove (journal->record_id);
+      journal->record_id = 0;
+    }
+
+  if (g_hash_table_size (journal->changed))
+    {
+      GLIDE_NOTE (DOCUMENT, "Journaling %u changed slides",
+		  g_hash_table_size (journal->changed));
+
+      for (i = 0; i < journal->slides->len; i++)
+	{
+	  GlideSlide *slide = GLIDE_SLIDE (g_ptr_array_index (journal->slides, i));
+
+	  if (g_hash_table_lookup (journal->changed, slide))
+	    glide_journal_record_slide (journal, "slide", slide, i);
+	}
+      g_hash_table_remove_all (journal->changed);
+    }
+
+  journal->action = NULL;
+  g_free (journal->label);
+  journal->label = NULL;
+}
+
+static gboolean
+glide_journal_record_idle (gpointer user_data)
+{
+  GlideJournal *journal = (GlideJournal *)user_data;
+
+  journal->record_id = 0;
+  glide_journal_record_changed (journal);
+
+  return FALSE;
+}
+
+static void
+glide_journal_queue_record (GlideJournal *journal)
+{
+  if (!journal->record_id)
+    journal->record_id = g_idle_add (glide_journal_record_idle, journal);
+}
+
+static void
+glide_journal_slide_changed_cb (GlideDocument *document,
+				GlideSlide *slide,
+				gpointer user_data)
+{
+  GlideJournal *journal = (GlideJournal *)user_data;
+
+  // Replaying the resize record scales the slides again.
+  if (journal->resizing)
+    return;
+
+  g_hash_table_insert (journal->changed, slide, slide);
+}
+
+/* For edits which don't go through the undo manager */
+void
+glide_journal_slide_edited (GlideJournal *journal, GlideSlide *slide)
+{
+  g_hash_table_insert (journal->changed, slide, slide);
+  glide_journal_queue_record (journal);
+}
+
+static void
+glide_journal_slide_added_cb (GlideDocument *document,
+			      GlideSlide *slide,
+			      gpointer user_data)
+{
+  GlideJournal *journal = (GlideJournal *)user_data;
+  GPtrArray *slides = journal->slides;
+  guint i, n_slides = glide_document_get_n_slides (document);
+
+  for (i = 0; i < n_slides; i++)
+    if (glide_document_get_nth_slide (document, i) == slide)
+      break;
+  if (i == n_slides)
+    return;
+
+  glide_journal_record_changed (journal);
+
+  // GPtrArray has no insert in the GLib we target
+  g_ptr_array_add (slides, NULL);
+  i = MIN (i, slides->len - 1);
+  memmove (slides->pdata + i + 1, slides->pdata + i,
+	   (slides->len - 1 - i) * sizeof (gpointer));
+  g_ptr_array_index (slides, i) = slide;
+
+  glide_journal_record_slide (journal, "insert-slide", slide, i);
+}
+
+static void
+glide_journal_slide_removed_cb (GlideDocument *document,
+				GlideSlide *slide,
+				gpointer user_data)
+{
+  GlideJournal *journal = (GlideJournal *)user_data;
+  guint i;
+
+  glide_journal_record_changed (journal);
+
+  for (i = 0; i < journal->slides->len; i++)
+    if (g_ptr_array_index (journal->slides, i) == slide)
+      {
+	g_ptr_array_remove_index (journal->slides, i);
+	glide_journal_push (journal, glide_journal_record_new ("remove-slide", i));
+	return;
+      }
+}
+
+static gboolean
+glide_journal_resize_done (gpointer user_data)
+{
+  GlideJournal *journal = (GlideJournal *)user_data;
+
+  journal->resizing = FALSE;
+  journal->resize_id = 0;
+
+  return FALSE;
+}
+
+static void
+glide_journal_resized_cb (GlideDocument *document,
+			  gpointer user_data)
+{
+  GlideJournal *journal = (GlideJournal *)user_data;
+  JsonObject *obj = glide_journal_record_new ("resize", -1);
+  gint width, height;
+
+  glide_journal_record_changed (journal);
+
+  glide_document_get_size (document, &width, &height);
+  json_object_set_int_member (obj, "width", width);
+  json_object_set_int_member (obj, "height", height);
+  glide_journal_push (journal, obj);
+
+  // The slides are resized after the signal, in the same main loop
+  // iteration, so ignore them until the next one.
+  journal->resizing = TRUE;
+  if (!journal->resize_id)
+    journal->resize_id = g_idle_add_full (G_PRIORITY_HIGH, glide_journal_resize_done,
+					  journal, NULL);
+}
+
+static void
+glide_journal_operation_cb (GlideUndoManager *undo_manager,
+			    gint operation,
+			    const gchar *label,
+			    gpointer user_data)
+{
+  GlideJournal *journal = (GlideJournal *)user_data;
+
+  switch (operation)
+    {
+    case GLIDE_UNDO_OPERATION_UNDO:
+      journal->action = "undo";
+      break;
+    case GLIDE_UNDO_OPERATION_REDO:
+      journal->action = "redo";
+      break;
+    default:
+      journal->action = "apply";
+      break;
+    }
+  g_free (journal->label);
+  journal->label = g_strdup (label);
+
+  glide_journal_queue_record (journal);
+}
+
+/*
+ * Starts journaling to the journal of document_path. With keep, records
+ * already there (say, recovered ones) are appended to, otherwise they
+ * are thrown away. undo_manager may be NULL.
+ */
+GlideJournal *
+glide_journal_new (GlideDocument *document,
+		   GlideUndoManager *undo_manager,
+		   const gchar *document_path,
+		   gboolean keep,
+		   GError **error)
+{
+  GlideJournal *journal;
+  gchar *path = glide_journal_get_path (document_path);
+  guint i, n_slides;
+  gint fd;
+
+  fd = glide_journal_open (path, keep, error);
+  if (fd < 0)
+    {
+      g_free (path);
+      return NULL;
+    }
+
+  journal = g_slice_new0 (GlideJournal);
+  journal->fd = fd;
+  journal->path = path;
+  journal->document_path = g_strdup (document_path);
+  journal->lock = g_mutex_new ();
+  journal->cond = g_cond_new ();
+
+  journal->thread = g_thread_create (glide_journal_flush_func, journal, TRUE, error);
+  if (!journal->thread)
+    {
+      g_mutex_free (journal->lock);
+      g_cond_free (journal->cond);
+      close (fd);
+      g_free (journal->path);
+      g_free (journal->document_path);
+      g_slice_free (GlideJournal, journal);
+      return NULL;
+    }
+
+  journal->document = g_object_ref (document);
+  journal->changed = g_hash_table_new (NULL, NULL);
+
+  n_slides = glide_document_get_n_slides (document);
+  journal->slides = g_ptr_array_sized_new (n_slides);
+  for (i = 0; i < n_slides; i++)
+    g_ptr_array_add (journal->slides, glide_document_get_nth_slide (document, i));
+
+  g_signal_connect (document, "slide-changed",
+		    G_CALLBACK (glide_journal_slide_changed_cb), journal);
+  g_signal_connect (document, "slide-added",
+		    G_CALLBACK (glide_journal_slide_added_cb), journal);
+  g_signal_connect (document, "slide-removed",
+		    G_CALLBACK (glide_journal_slide_removed_cb), journal);
+  g_signal_connect (document, "resized",
+		    G_CALLBACK (glide_journal_resized_cb), journal);
+
+  if (undo_manager)
+    {
+      journal->undo_manager = g_object_ref (undo_manager);
+      g_signal_connect (undo_manager, "operation",
+			G_CALLBACK (glide_journal_operation_cb), journal);
+    }
+
+  GLIDE_NOTE (DOCUMENT, "Journaling %s to %s", document_path, path);
+
+  return journal;
+}
+
+static void
+glide_journal_record_free (GlideJournalRecord *record)
+{
+  g_free (record->line);
+  g_slice_free (GlideJournalRecord, record);
+}
+
+static void
+glide_journal_free_pending (GlideJournal *journal)
+{
+  GList *r;
+
+  for (r = journal->pending.head; r; r = r->next)
+    g_free (r->data);
+  g_queue_clear (&journal->pending);
+}
+
+/*
+ * Writes out what is left and stops the journal. With remove the
+ * changes are either saved or unwanted, and the file is deleted.
+ */
+void
+glide_journal_free (GlideJournal *journal, gboolean remove)
+{
+  GlideJournalRecord *record;
+
+  g_signal_handlers_disconnect_matched (journal->document, G_SIGNAL_MATCH_DATA,
+					0, 0, NULL, NULL, journal);
+  if (journal->undo_manager)
+    {
+      g_signal_handlers_disconnect_matched (journal->undo_manager, G_SIGNAL_MATCH_DATA,
+					    0, 0, NULL, NULL, journal);
+      g_object_unref (journal->undo_manager);
+    }
+
+  if (!remove)
+    glide_journal_record_changed (journal);
+  if (journal->record_id)
+    g_source_remove (journal->record_id);
+  if (journal->resize_id)
+    g_source_remove (journal->resize_id);
+
+  if (remove)
+    {
+      g_mutex_lock (journal->lock);
+      glide_journal_free_pending (journal);
+      g_mutex_unlock (journal->lock);
+    }
+  glide_journal_stop_thread (journal);
+
+  close (journal->fd);
+  if (remove)
+    g_unlink (journal->path);
+
+  GLIDE_NOTE (DOCUMENT, "Closed journal %s%s", journal->path, remove ? " (removed)" : "");
+
+  while ((record = g_queue_pop_head (&journal->retained)))
+    glide_journal_record_free (record);
+  g_queue_clear (&journal->checkpoints);
+
+  g_mutex_free (journal->lock);
+  g_cond_free (journal->cond);
+
+  g_hash_table_destroy (journal->changed);
+  g_ptr_array_free (journal->slides, TRUE);
+  g_object_unref (journal->document);
+
+  g_free (journal->label);
+  g_free (journal->path);
+  g_free (journal->document_path);
+  g_slice_free (GlideJournal, journal);
+}
+
+const gchar *
+glide_journal_get_document_path (GlideJournal *journal)
+{
+  return journal->document_path;
+}
+
+/*
+ * Moves the journal next to document_path, once the document is saved
+ * there. The records go with it, so nothing is lost while saves are in
+ * progress, and whatever was left next to document_path is replaced.
+ */
+gboolean
+glide_journal_set_document_path (GlideJournal *journal,
+				 const gchar *document_path,
+				 GError **error)
+{
+  gchar *path = glide_journal_get_path (document_path);
+  gchar *contents = NULL;
+  gsize length = 0;
+  gint fd, old_fd;
+
+  if (!strcmp (path, journal->path))
+    {
+      g_free (path);
+      return TRUE;
+    }
+
+  fd = glide_journal_open (path, FALSE, error);
+  if (fd < 0)
+    {
+      g_free (path);
+      return FALSE;
+    }
+
+  GLIDE_NOTE (DOCUMENT, "Moving journal %s to %s", journal->path, path);
+
+  // With the thread gone everything is written, and the old file is complete.
+  glide_journal_stop_thread (journal);
+  if (!g_file_get_contents (journal->path, &contents, &length, NULL))
+    g_warning ("Failed to read journal %s, records since the last save are lost",
+	       journal->path);
+
+  old_fd = journal->fd;
+  journal->fd = fd;
+  close (old_fd);
+  g_unlink (journal->path);
+
+  g_free (journal->path);
+  journal->path = path;
+  g_free (journal->document_path);
+  journal->document_path = g_strdup (document_path);
+
+  if (length)
+    glide_journal_write (journal, contents, length);
+  g_free (contents);
+
+  journal->thread = g_thread_create (glide_journal_flush_func, journal, TRUE, NULL);
+
+  return TRUE;
+}
+
+/*
+ * Call as the document is snapshotted for saving. Records made from
+ * here on are kept, so that once the save lands the journal can be
+ * emptied of everything else.
+ */
+guint
+glide_journal_begin_checkpoint (GlideJournal *journal)
+{
+  glide_journal_record_changed (journal);
+
+  g_queue_push_tail (&journal->checkpoints, GUINT_TO_POINTER (journal->next_seq));
+
+  return journal->next_seq;
+}
+
+void
+glide_journal_end_checkpoint (GlideJournal *journal,
+			      guint checkpoint,
+			      gboolean saved)
+{
+  GlideJournalRecord *record;
+
+  if (!g_queue_remove (&journal->checkpoints, GUINT_TO_POINTER (checkpoint)))
+    return;
+
+  if (saved)
+    {
+      GList *rewrite = NULL, *r;
+
+      while ((record = g_queue_peek_head (&journal->retained)) && record->seq < checkpoint)
+	glide_journal_record_free (g_queue_pop_head (&journal->retained));
+
+      for (r = journal->retained.tail; r; r = r->prev)
+	rewrite = g_list_prepend (rewrite, g_strdup (((GlideJournalRecord *)r->data)->line));
+
+      GLIDE_NOTE (DOCUMENT, "Compacting journal %s to %u records",
+		  journal->path, g_list_length (rewrite));
+
+      // Everything waiting to be written is either saved or rewritten.
+      g_mutex_lock (journal->lock);
+      glide_journal_free_pending (journal);
+      journal->pending.head = rewrite;
+      journal->pending.tail = g_list_last (rewrite);
+      journal->pending.length = g_list_length (rewrite);
+      journal->truncate = TRUE;
+      g_cond_signal (journal->cond);
+      g_mutex_unlock (journal->lock);
+    }
+
+  if (!journal->checkpoints.length)
+    while ((record = g_queue_pop_head (&journal->retained)))
+      glide_journal_record_free (record);
+}
+
+static gboolean
+glide_journal_replay_record (GlideDocument *document, JsonObject *obj)
+{
+  const gchar *op = glide_json_object_get_string (obj, "op");
+  JsonObject *data = NULL;
+  gint index = -1;
+
+  if (!op)
+    return FALSE;
+  if (json_object_has_member (obj, "slide"))
+    index = json_object_get_int_member (obj, "slide");
+  if (json_object_has_member (obj, "data"))
+    data = json_object_get_object_member (obj, "data");
+
+  if (!strcmp (op, "slide"))
+    {
+      GlideSlide *slide;
+
+      if (index < 0 || !data || !(slide = glide_document_get_nth_slide (document, index)))
+	return FALSE;
+      glide_slide_replace_from_json (slide, data);
+    }
+  else if (!strcmp (op, "insert-slide"))
+    {
+      GlideSlide *slide;
+
+      if (index < 0)
+	return FALSE;
+      slide = glide_document_insert_slide (document, index - 1);
+      if (data)
+	glide_slide_replace_from_json (slide, data);
+    }
+  else if (!strcmp (op, "remove-slide"))
+    {
+      if (index < 0 || index >= glide_document_get_n_slides (document))
+	return FALSE;
+      glide_document_remove_slide (document, index);
+    }
+  else if (!strcmp (op, "resize"))
+    {
+      if (!json_object_has_member (obj, "width") || !json_object_has_member (obj, "height"))
+	return FALSE;
+      glide_document_resize (document,
+			     json_object_get_int_member (obj, "width"),
+			     json_object_get_int_member (obj, "height"));
+    }
+  else
+    return FALSE;
+
+  return TRUE;
+}
+
+/*
+ * Applies the journal left by a previous session to document, which
+ * should be freshly loaded from document_path. Returns the number of
+ * records applied, or -1 if the journal couldn't be read.
+ */
+gint
+glide_journal_replay (GlideDocument *document,
+		      const gchar *document_path,
+		      GError **error)
+{
+  gchar *path = glide_journal_get_path (document_path);
+  JsonParser *parser;
+  gchar *contents, **lines;
+  gint i, n_applied = 0;
+
+  if (!g_file_get_contents (path, &contents, NULL, error))
+    {
+      g_free (path);
+      return -1;
+    }
+
+  parser = json_parser_new ();
+  lines = g_strsplit (contents, "\n", -1);
+  for (i = 0; lines[i]; i++)
+    {
+      JsonNode *root;
+
+      if (!*lines[i])
+	continue;
+
+      // A crash in the middle of a write leaves the last line torn.
+      if (!json_parser_load_from_data (parser, lines[i], -1, NULL) ||
+	  !(root = json_parser_get_root (parser)) ||
+	  JSON_NODE_TYPE (root) != JSON_NODE_OBJECT)
+	{
+	  GLIDE_NOTE (DOCUMENT, "Stopped replaying %s at unreadable line %d", path, i + 1);
+	  break;
+	}
+
+      if (glide_journal_replay_record (document, json_node_get_object (root)))
+	n_applied++;
+      else
+	g_warning ("Skipping bad record on line %d of journal %s", i + 1, path);
+    }
+
+  GLIDE_NOTE (DOCUMENT, "Replayed %d records from %s", n_applied, path);
+
+  g_strfreev (lines);
+  g_object_unref (parser);
+  g_free (contents);
+  g_free (path);
+
+  return n_applied;
+}
@@ -0,0 +1,54 @@
+/*
+ * glide-journal.h
+ * This file is part of glide
+ *
+ * Copyright (C) 2010 - Robert Carr
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GLIDE_JOURNAL_H__
+#define __GLIDE_JOURNAL_H__
+
+#include <glib.h>
+
+#include "glide-document.h"
+#include "glide-slide.h"
+#include "glide-undo-manager.h"
+
+G_BEGIN_DECLS
+
+typedef struct _GlideJournal GlideJournal;
+
+gchar *glide_journal_get_path (const gchar *document_path);
+gint glide_journal_replay (GlideDocument *document, const gchar *document_path, GError **error);
+
+GlideJournal *glide_journal_new (GlideDocument *document, GlideUndoManager *undo_manager,
+				 const gchar *document_path, gboolean keep, GError **error);
+void glide_journal_free (GlideJournal *journal, gboolean remove);
+
+const gchar *glide_journal_get_document_path (GlideJournal *journal);
+gboolean glide_journal_set_document_path (GlideJournal *journal, const gchar *document_path,
+					  GError **error);
+
+void glide_journal_slide_edited (GlideJournal *journal, GlideSlide *slide);
+
+guint glide_journal_begin_checkpoint (GlideJournal *journal);
+void glide_journal_end_checkpoint (GlideJournal *journal, guint checkpoint, gboolean saved);
+
+G_END_DECLS
+
+#endif
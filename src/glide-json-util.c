@@ -22,7 +22,13 @@
 
 #include "glide-json-util.h"
 #include <math.h>
-#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <glib/gstdio.h>
+
+#include "glide-debug.h"
 
 void
 glide_json_object_set_string (JsonObject *obj, const gchar *prop, const gchar *value)
@@ -44,61 +50,495 @@ glide_json_object_get_string (JsonObject *obj, const gchar *prop)
   return json_node_get_string (n);
 }
 
-void
-glide_json_object_set_double (JsonObject *obj, const gchar *prop, gdouble value)
+static gdouble glide_json_node_get_double (JsonNode *n);
+
+/*
+ * Older json-glib generators print doubles with too few digits to
+ * read back the same value. Checked once by writing and parsing a few
+ * awkward values.
+ */
+static gboolean
+glide_json_doubles_round_trip (void)
 {
-  gchar *s;
-  JsonNode *n = json_node_new (JSON_NODE_VALUE);
+  static gsize checked = 0;
+  static gboolean exact = FALSE;
   
-  s = g_strdup_printf("%g",value);
+  if (g_once_init_enter (&checked))
+    {
+      const gdouble values[] = {1.0 / 3.0, 0.1, 1e-7, 12345.678f, 1e22};
+      JsonGenerator *gen = json_generator_new ();
+      JsonParser *parser = json_parser_new ();
+      JsonNode *root = json_node_new (JSON_NODE_ARRAY);
+      JsonArray *array = json_array_new ();
+      gchar *data;
+      guint i;
+      
+      json_node_take_array (root, array);
+      for (i = 0; i < G_N_ELEMENTS (values); i++)
+	json_array_add_double_element (array, values[i]);
+      
+      json_generator_set_root (gen, root);
+      data = json_generator_to_data (gen, NULL);
+      
+      exact = json_parser_load_from_data (parser, data, -1, NULL) &&
+	JSON_NODE_TYPE (json_parser_get_root (parser)) == JSON_NODE_ARRAY;
+      if (exact)
+	{
+	  array = json_node_get_array (json_parser_get_root (parser));
+	  exact = json_array_get_length (array) == G_N_ELEMENTS (values);
+	  for (i = 0; exact && i < G_N_ELEMENTS (values); i++)
+	    exact = glide_json_node_get_double (json_array_get_element (array, i)) == values[i];
+	}
+      
+      if (!exact)
+	GLIDE_NOTE (DOCUMENT, "json-glib loses precision on doubles (%s), saving them as strings", data);
+      
+      g_free (data);
+      json_node_free (root);
+      g_object_unref (parser);
+      g_object_unref (gen);
+      
+      g_once_init_leave (&checked, 1);
+    }
   
-  json_node_set_string(n, s);
+  return exact;
+}
+
+/*
+ * Whole numbers are written as integers. Other values are JSON doubles,
+ * or strings holding every digit when the generator can't keep them.
+ */
+static JsonNode *
+glide_json_node_new_number (gdouble value)
+{
+  JsonNode *n = json_node_new (JSON_NODE_VALUE);
+  
+  if (value == floor (value) && fabs (value) < 1e15)
+    json_node_set_int (n, (gint64) value);
+  else if (glide_json_doubles_round_trip ())
+    json_node_set_double (n, value);
+  else
+    {
+      gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
+      
+      json_node_set_string (n, g_ascii_dtostr (buf, sizeof (buf), value));
+    }
   
-  g_free (s);
+  return n;
+}
 
-  json_object_set_member (obj, prop, n);
+void
+glide_json_object_set_double (JsonObject *obj, const gchar *prop, gdouble value)
+{
+  json_object_set_member (obj, prop, glide_json_node_new_number (value));
+}
+
+/*
+ * Numbers are written as JSON numbers since schema version 2, which
+ * may read back as integers, or as strings where the generator would
+ * round them. Older files stored them all as strings.
+ */
+static gdouble
+glide_json_node_get_double (JsonNode *n)
+{
+  if (!n || JSON_NODE_TYPE (n) != JSON_NODE_VALUE)
+    return 0;
+  
+  switch (json_node_get_value_type (n))
+    {
+    case G_TYPE_DOUBLE:
+      return json_node_get_double (n);
+    case G_TYPE_INT64:
+      return json_node_get_int (n);
+    case G_TYPE_STRING:
+      return g_ascii_strtod (json_node_get_string (n), NULL);
+    default:
+      return 0;
+    }
 }
 
 gdouble
 glide_json_object_get_double (JsonObject *obj, const char *prop)
 {
-  JsonNode *n = json_object_get_member (obj, prop);
-  const gchar *ds;
+  return glide_json_node_get_double (json_object_get_member (obj, prop));
+}
+
+gboolean
+glide_json_object_get_geometry (JsonObject *obj, gdouble *x, gdouble *y,
+				gdouble *width, gdouble *height)
+{
+  JsonNode *n = json_object_get_member (obj, "geometry");
   
-  ds = json_node_get_string (n);
+  if (!n)
+    return FALSE;
   
-  return atof (ds);
+  // Version 2 stores [x, y, width, height].
+  if (JSON_NODE_TYPE (n) == JSON_NODE_ARRAY)
+    {
+      JsonArray *geom = json_node_get_array (n);
+      
+      if (json_array_get_length (geom) < 4)
+	return FALSE;
+      
+      *x = glide_json_node_get_double (json_array_get_element (geom, 0));
+      *y = glide_json_node_get_double (json_array_get_element (geom, 1));
+      *width = glide_json_node_get_double (json_array_get_element (geom, 2));
+      *height = glide_json_node_get_double (json_array_get_element (geom, 3));
+    }
+  else
+    {
+      JsonObject *geom_obj = json_node_get_object (n);
+      
+      *x = glide_json_object_get_double (geom_obj, "x");
+      *y = glide_json_object_get_double (geom_obj, "y");
+      *width = glide_json_object_get_double (geom_obj, "width");
+      *height = glide_json_object_get_double (geom_obj, "height");
+    }
+  
+  return TRUE;
 }
 
 void
 glide_json_object_restore_actor_geometry (JsonObject *obj, ClutterActor *actor)
 {
-  JsonNode *n = json_object_get_member (obj, "geometry");
-  JsonObject *geom_obj = json_node_get_object (n);
-  clutter_actor_set_size (actor,
-			  glide_json_object_get_double(geom_obj, "width"),
-			  glide_json_object_get_double(geom_obj, "height"));
-  clutter_actor_set_position (actor,
-			      glide_json_object_get_double(geom_obj, "x"),
-			      glide_json_object_get_double(geom_obj, "y"));
+  gdouble x, y, width, height;
+  
+  if (!glide_json_object_get_geometry (obj, &x, &y, &width, &height))
+    return;
+  
+  clutter_actor_set_size (actor, width, height);
+  clutter_actor_set_position (actor, x, y);
+}
+
+void
+glide_json_object_set_geometry (JsonObject *obj, gdouble x, gdouble y,
+				gdouble width, gdouble height)
+{
+  JsonNode *n = json_node_new (JSON_NODE_ARRAY);
+  JsonArray *geom = json_array_sized_new (4);
+  
+  json_node_take_array (n, geom);
+  
+  json_array_add_element (geom, glide_json_node_new_number (x));
+  json_array_add_element (geom, glide_json_node_new_number (y));
+  json_array_add_element (geom, glide_json_node_new_number (width));
+  json_array_add_element (geom, glide_json_node_new_number (height));
+  
+  json_object_set_member (obj, "geometry", n);
 }
 
 void
 glide_json_object_add_actor_geometry (JsonObject *obj, ClutterActor *actor)
 {
-  JsonNode *n = json_node_new (JSON_NODE_OBJECT);
-  JsonObject *geom_obj = json_object_new ();
   gfloat width, height, x, y;
   
-  json_node_set_object (n, geom_obj);
-  
   clutter_actor_get_position (actor, &x, &y);
-  clutter_actor_get_size (actor, &width, &height);  
+  clutter_actor_get_size (actor, &width, &height);
+  
+  glide_json_object_set_geometry (obj, x, y, width, height);
+}
+
+#define STREAM_CHUNK_SIZE 65536
 
-  glide_json_object_set_double (geom_obj, "x", x);
-  glide_json_object_set_double (geom_obj, "y", y);
-  glide_json_object_set_double (geom_obj, "width", width);
-  glide_json_object_set_double (geom_obj, "height", height);
+typedef enum {
+  STREAM_ROOT,
+  STREAM_MEMBER_START,
+  STREAM_KEY,
+  STREAM_COLON,
+  STREAM_VALUE_START,
+  STREAM_VALUE,
+  STREAM_ELEMENT_START,
+  STREAM_ELEMENT,
+  STREAM_MEMBER_END,
+  STREAM_DONE
+} GlideJsonStreamState;
+
+typedef struct _GlideJsonStream {
+  const gchar *array_member;
+  GlideJsonStreamMemberFunc member_func;
+  GlideJsonStreamElementFunc element_func;
+  gpointer user_data;
   
-  json_object_set_member (obj, "geometry", n);
+  JsonParser *parser;
+  
+  GlideJsonStreamState state;
+  guint depth;
+  gboolean in_string;
+  gboolean escape;
+  guint line;
+  
+  GString *key;
+  GString *buffer;
+} GlideJsonStream;
+
+static gboolean
+glide_json_stream_error (GlideJsonStream *stream, const gchar *message, GError **error)
+{
+  g_set_error (error, JSON_PARSER_ERROR, JSON_PARSER_ERROR_PARSE,
+	       "%u: %s", stream->line, message);
+  return FALSE;
+}
+
+/* Any other member is parsed wrapped in an object of its own */
+static gboolean
+glide_json_stream_finish_value (GlideJsonStream *stream, GError **error)
+{
+  gchar *data = g_strdup_printf ("{\"%s\":%s}", stream->key->str, stream->buffer->str);
+  gboolean ret = json_parser_load_from_data (stream->parser, data, -1, error);
+  
+  if (ret && stream->member_func)
+    stream->member_func (stream->key->str,
+			 json_node_get_object (json_parser_get_root (stream->parser)),
+			 stream->user_data);
+  
+  g_free (data);
+  g_string_truncate (stream->buffer, 0);
+  
+  return ret;
+}
+
+static gboolean
+glide_json_stream_finish_element (GlideJsonStream *stream, GError **error)
+{
+  JsonNode *root;
+  
+  if (!json_parser_load_from_data (stream->parser, stream->buffer->str, stream->buffer->len, error))
+    return FALSE;
+  g_string_truncate (stream->buffer, 0);
+  
+  root = json_parser_get_root (stream->parser);
+  if (JSON_NODE_TYPE (root) == JSON_NODE_OBJECT && stream->element_func)
+    stream->element_func (json_node_get_object (root), stream->user_data);
+  
+  return TRUE;
+}
+
+/* Collects the text of a member value, or of an element of the array */
+static gboolean
+glide_json_stream_capture (GlideJsonStream *stream, gchar c, GError **error)
+{
+  gboolean element = stream->state == STREAM_ELEMENT;
+  guint top = element ? 2 : 1;
+  
+  if (stream->depth == top && (c == ',' || c == (element ? ']' : '}')))
+    {
+      if (!(element ? glide_json_stream_finish_element (stream, error)
+	    : glide_json_stream_finish_value (stream, error)))
+	return FALSE;
+      
+      if (c == ',')
+	stream->state = element ? STREAM_ELEMENT_START : STREAM_MEMBER_START;
+      else if (element)
+	{
+	  stream->depth = 1;
+	  stream->state = STREAM_MEMBER_END;
+	}
+      else
+	{
+	  stream->depth = 0;
+	  stream->state = STREAM_DONE;
+	}
+      return TRUE;
+    }
+  
+  if (c == '{' || c == '[')
+    stream->depth++;
+  else if (c == '}' || c == ']')
+    {
+      if (stream->depth == top)
+	return glide_json_stream_error (stream, "Unbalanced brackets", error);
+      stream->depth--;
+    }
+  else if (c == '"')
+    stream->in_string = TRUE;
+  
+  g_string_append_c (stream->buffer, c);
+  
+  return TRUE;
+}
+
+static gboolean
+glide_json_stream_feed (GlideJsonStream *stream, const gchar *data, gsize length, GError **error)
+{
+  gsize i;
+  
+  for (i = 0; i < length; i++)
+    {
+      gchar c = data[i];
+      
+      if (c == '\n')
+	stream->line++;
+      
+      if (stream->in_string)
+	{
+	  gboolean end = c == '"' && !stream->escape;
+	  
+	  stream->escape = !stream->escape && c == '\\';
+	  if (stream->state == STREAM_KEY)
+	    {
+	      if (end)
+		stream->state = STREAM_COLON;
+	      else
+		g_string_append_c (stream->key, c);
+	    }
+	  else
+	    g_string_append_c (stream->buffer, c);
+	  
+	  if (end)
+	    stream->in_string = FALSE;
+	  continue;
+	}
+      
+      if (stream->state == STREAM_VALUE || stream->state == STREAM_ELEMENT)
+	{
+	  if (!glide_json_stream_capture (stream, c, error))
+	    return FALSE;
+	  continue;
+	}
+      
+      if (g_ascii_isspace (c))
+	continue;
+      
+      switch (stream->state)
+	{
+	case STREAM_ROOT:
+	  if (c != '{')
+	    return glide_json_stream_error (stream, "Expected an object", error);
+	  stream->depth = 1;
+	  stream->state = STREAM_MEMBER_START;
+	  break;
+	  
+	case STREAM_MEMBER_START:
+	  if (c == '}')
+	    {
+	      stream->depth = 0;
+	      stream->state = STREAM_DONE;
+	    }
+	  else if (c == '"')
+	    {
+	      g_string_truncate (stream->key, 0);
+	      stream->in_string = TRUE;
+	      stream->state = STREAM_KEY;
+	    }
+	  else
+	    return glide_json_stream_error (stream, "Expected a member name", error);
+	  break;
+	  
+	case STREAM_COLON:
+	  if (c != ':')
+	    return glide_json_stream_error (stream, "Expected ':'", error);
+	  stream->state = STREAM_VALUE_START;
+	  break;
+	  
+	case STREAM_VALUE_START:
+	  if (c == '[' && !strcmp (stream->key->str, stream->array_member))
+	    {
+	      stream->depth = 2;
+	      stream->state = STREAM_ELEMENT_START;
+	      break;
+	    }
+	  stream->state = STREAM_VALUE;
+	  if (!glide_json_stream_capture (stream, c, error))
+	    return FALSE;
+	  break;
+	  
+	case STREAM_ELEMENT_START:
+	  if (c == ']')
+	    {
+	      stream->depth = 1;
+	      stream->state = STREAM_MEMBER_END;
+	      break;
+	    }
+	  stream->state = STREAM_ELEMENT;
+	  if (!glide_json_stream_capture (stream, c, error))
+	    return FALSE;
+	  break;
+	  
+	case STREAM_MEMBER_END:
+	  if (c == ',')
+	    stream->state = STREAM_MEMBER_START;
+	  else if (c == '}')
+	    {
+	      stream->depth = 0;
+	      stream->state = STREAM_DONE;
+	    }
+	  else
+	    return glide_json_stream_error (stream, "Expected ',' or '}'", error);
+	  break;
+	  
+	default:
+	  return glide_json_stream_error (stream, "Data after the end of the document", error);
+	}
+    }
+  
+  return TRUE;
+}
+
+/*
+ * Reads the JSON object in filename a chunk at a time, without ever
+ * holding all of it. Each element of the array member array_member is
+ * parsed on its own and handed to element_func as soon as it is read,
+ * so only one of them is in memory unless element_func keeps it. Every
+ * other member is handed to member_func, in an object holding just it.
+ */
+gboolean
+glide_json_stream_object_file (const gchar *filename,
+			       const gchar *array_member,
+			       GlideJsonStreamMemberFunc member_func,
+			       GlideJsonStreamElementFunc element_func,
+			       gpointer user_data,
+			       GError **error)
+{
+  GlideJsonStream stream = { 0, };
+  gchar *chunk;
+  FILE *f;
+  gboolean ret = TRUE;
+  
+  f = g_fopen (filename, "rb");
+  if (!f)
+    {
+      gint save_errno = errno;
+      
+      g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (save_errno),
+		   "Failed to open '%s': %s", filename, g_strerror (save_errno));
+      return FALSE;
+    }
+  
+  stream.array_member = array_member;
+  stream.member_func = member_func;
+  stream.element_func = element_func;
+  stream.user_data = user_data;
+  stream.parser = json_parser_new ();
+  stream.state = STREAM_ROOT;
+  stream.line = 1;
+  stream.key = g_string_new (NULL);
+  stream.buffer = g_string_new (NULL);
+  
+  chunk = g_malloc (STREAM_CHUNK_SIZE);
+  while (ret)
+    {
+      gsize length = fread (chunk, 1, STREAM_CHUNK_SIZE, f);
+      
+      if (length)
+	ret = glide_json_stream_feed (&stream, chunk, length, error);
+      if (length < STREAM_CHUNK_SIZE)
+	break;
+    }
+  
+  if (ret && ferror (f))
+    {
+      g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_IO,
+		   "Failed to read '%s'", filename);
+      ret = FALSE;
+    }
+  else if (ret && stream.state != STREAM_DONE)
+    ret = glide_json_stream_error (&stream, "Unexpected end of the document", error);
+  
+  fclose (f);
+  g_free (chunk);
+  g_string_free (stream.key, TRUE);
+  g_string_free (stream.buffer, TRUE);
+  g_object_unref (stream.parser);
+  
+  return ret;
 }
@@ -29,8 +29,22 @@ void glide_json_object_set_string (JsonObject *obj, const gchar *prop, const gch
 const gchar *glide_json_object_get_string (JsonObject *obj, const gchar *prop);
 
 void glide_json_object_set_double (JsonObject *obj, const gchar *prop, gdouble value);
+gdouble glide_json_object_get_double (JsonObject *obj, const gchar *prop);
+
+gboolean glide_json_object_get_geometry (JsonObject *obj, gdouble *x, gdouble *y,
+					 gdouble *width, gdouble *height);
+void glide_json_object_set_geometry (JsonObject *obj, gdouble x, gdouble y,
+				     gdouble width, gdouble height);
 
 void glide_json_object_add_actor_geometry (JsonObject *obj, ClutterActor *actor);
 void glide_json_object_restore_actor_geometry (JsonObject *obj, ClutterActor *actor);
 
+typedef void (*GlideJsonStreamMemberFunc) (const gchar *member_name, JsonObject *member, gpointer user_data);
+typedef void (*GlideJsonStreamElementFunc) (JsonObject *element, gpointer user_data);
+
+gboolean glide_json_stream_object_file (const gchar *filename, const gchar *array_member,
+					GlideJsonStreamMemberFunc member_func,
+					GlideJsonStreamElementFunc element_func,
+					gpointer user_data, GError **error);
+
 #endif
@@ -63,9 +63,6 @@ struct _GlideManipulatorPrivate
   
   gboolean width_only;
   
-  CoglHandle widget_material;
-  CoglHandle widget_active_material;
-  
   gboolean motion_since_press;
 };
 
@@ -30,6 +30,7 @@
 
 #include "glide-manipulator-priv.h"
 #include "glide-dirs.h"
+#include "glide-texture-cache.h"
 
 
 G_DEFINE_TYPE(GlideManipulator, glide_manipulator, CLUTTER_TYPE_RECTANGLE)
@@ -45,21 +46,21 @@ enum {
 #define GLIDE_MANIPULATOR_BORDER_WIDTH 1.5
 #define GLIDE_MANIPULATOR_WIDGET_WIDTH 7.5
 
+/* Shared by every manipulator, see glide_manipulator_load_textures */
+static CoglHandle widget_material = COGL_INVALID_HANDLE;
+static CoglHandle widget_active_material = COGL_INVALID_HANDLE;
+
+static void glide_manipulator_watch_target (GlideManipulator *manip, ClutterActor *target);
 
 static void
 glide_manipulator_finalize (GObject *object)
 {
-  GlideManipulator *m = GLIDE_MANIPULATOR(object);
+  glide_manipulator_watch_target (GLIDE_MANIPULATOR (object), NULL);
+  
   GLIDE_NOTE (MANIPULATOR,
 	      "finalizing manipulator '%s'",
 	      GLIDE_ACTOR_DISPLAY_NAME (CLUTTER_ACTOR (object)));
   
-  cogl_handle_unref (m->priv->widget_material);
-  m->priv->widget_material = COGL_INVALID_HANDLE;
-
-  cogl_handle_unref (m->priv->widget_active_material);
-  m->priv->widget_active_material = COGL_INVALID_HANDLE;
-
   G_OBJECT_CLASS (glide_manipulator_parent_class)->finalize (object);
 }
 
@@ -167,10 +168,10 @@ glide_manipulator_paint_widget (GlideManipulator *manip,
 
   if (manip->priv->hovered == widg ||
       manip->priv->resize_widget == widg)
-    cogl_set_source (manip->priv->widget_active_material);
+    cogl_set_source (widget_active_material);
 
   else
-    cogl_set_source (manip->priv->widget_material);
+    cogl_set_source (widget_material);
   
   switch (widg)
     {
@@ -342,12 +343,50 @@ glide_manipulator_sync_transforms (ClutterActor *manipulator,
 				   ClutterActor *target)
 {
   gfloat tx, ty, tw, th;
+  gfloat mx, my, mw, mh;
   
   clutter_actor_get_size (target, &tw, &th);
   clutter_actor_get_position (target, &tx, &ty);
   
-  clutter_actor_set_position (manipulator, tx, ty);
-  clutter_actor_set_size (manipulator, tw, th);
+  clutter_actor_get_size (manipulator, &mw, &mh);
+  clutter_actor_get_position (manipulator, &mx, &my);
+  
+  // Setting either queues a redraw, so only do it on a real change.
+  if (tx != mx || ty != my)
+    clutter_actor_set_position (manipulator, tx, ty);
+  if (tw != mw || th != mh)
+    clutter_actor_set_size (manipulator, tw, th);
+}
+
+static void
+glide_manipulator_target_geometry_notify (GObject *object,
+					  GParamSpec *pspec,
+					  gpointer user_data)
+{
+  GlideManipulator *manip = (GlideManipulator *)user_data;
+  
+  glide_manipulator_sync_transforms (CLUTTER_ACTOR (manip), CLUTTER_ACTOR (object));
+}
+
+static void
+glide_manipulator_watch_target (GlideManipulator *manip,
+				ClutterActor *target)
+{
+  static const gchar *signals[] = {"notify::allocation", "notify::x", "notify::y",
+				   "notify::width", "notify::height"};
+  guint i;
+  
+  if (manip->priv->target)
+    g_signal_handlers_disconnect_by_func (manip->priv->target,
+					  glide_manipulator_target_geometry_notify,
+					  manip);
+  if (!target)
+    return;
+  
+  for (i = 0; i < G_N_ELEMENTS (signals); i++)
+    g_signal_connect (target, signals[i],
+		      G_CALLBACK (glide_manipulator_target_geometry_notify),
+		      manip);
 }
 
 
@@ -357,8 +396,6 @@ glide_manipulator_paint (ClutterActor *self)
   GlideManipulator *manip = GLIDE_MANIPULATOR (self);
   ClutterGeometry geom;
   ClutterColor border_color = {0x00, 0x00, 0x00, 0xcc};
-  
-  glide_manipulator_sync_transforms (CLUTTER_ACTOR (manip), manip->priv->target);
 
   GLIDE_NOTE (PAINT,
 	      "painting manipulator '%s'",
@@ -373,9 +410,6 @@ glide_manipulator_paint (ClutterActor *self)
   
   glide_manipulator_paint_border (&border_color, &geom);
   glide_manipulator_paint_widgets (manip, &geom);
-
-  if (manip->priv->target)
-    clutter_actor_queue_redraw (manip->priv->target);
 }
 
 static void
@@ -662,8 +696,11 @@ glide_manipulator_set_target_real (GlideManipulator *manip,
 {
   gfloat x,y, width, height, rx, ry, rz, za;
   
+  glide_manipulator_watch_target (manip, target);
+  
   if (!target)
     {
+      manip->priv->target = NULL;
       clutter_actor_hide (CLUTTER_ACTOR (manip));
       return ;
     }
@@ -755,37 +792,39 @@ static CoglHandle
 glide_manipulator_material_for_file (const gchar *filename)
 {
   GError *e = NULL;
-  CoglHandle m, t;
-  
-  m = cogl_material_new ();
-  t = cogl_texture_new_from_file(filename,
-				 COGL_TEXTURE_NONE,
-				 COGL_PIXEL_FORMAT_ANY,
-				 &e);
-  if (e || t == COGL_INVALID_HANDLE)
+  CoglHandle m;
+  
+  m = glide_texture_cache_get_material (filename, &e);
+  if (m == COGL_INVALID_HANDLE)
     {
       g_warning ("glide-manipulator.c failed to load widget image: %s", filename);
       g_error_free (e);
+      
+      m = cogl_material_new ();
     }
-  cogl_material_set_layer (m, 0, t);
-  cogl_material_set_layer_filters (m, 0,
-				   COGL_MATERIAL_FILTER_LINEAR_MIPMAP_LINEAR,
-				   COGL_MATERIAL_FILTER_LINEAR);
-  cogl_handle_unref (t);
   
   return m;
 }
 
 static void
-glide_manipulator_load_textures (GlideManipulator *manipulator)
+glide_manipulator_load_textures (void)
 {
-  gchar *image_dir = glide_dirs_get_glide_image_dir ();
-  gchar *p1 = g_build_filename(image_dir, "manipulator-widget.png", NULL);
-  gchar *p2 = g_build_filename(image_dir, "manipulator-widget-active.png",
-			       NULL);
+  gchar *image_dir, *p1, *p2;
+  
+  if (widget_material != COGL_INVALID_HANDLE)
+    return;
+  
+  image_dir = glide_dirs_get_glide_image_dir ();
+  p1 = g_build_filename(image_dir, "manipulator-widget.png", NULL);
+  p2 = g_build_filename(image_dir, "manipulator-widget-active.png",
+			NULL);
 
-  manipulator->priv->widget_material = glide_manipulator_material_for_file(p1);
-  manipulator->priv->widget_active_material = glide_manipulator_material_for_file(p2);  
+  widget_material = glide_manipulator_material_for_file(p1);
+  widget_active_material = glide_manipulator_material_for_file(p2);
+  
+  g_free (image_dir);
+  g_free (p1);
+  g_free (p2);
 }
 
 static void
@@ -796,7 +835,7 @@ glide_manipulator_init (GlideManipulator *manipulator)
   
   manipulator->priv->mode = WIDGET_MODE_RESIZE;
 
-  glide_manipulator_load_textures (manipulator);
+  glide_manipulator_load_textures ();
   
   clutter_actor_set_reactive (CLUTTER_ACTOR (manipulator), TRUE);
 }
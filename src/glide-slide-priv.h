@@ -36,12 +36,22 @@ struct _GlideSlidePrivate
   
   gchar *background;
   gchar *animation;
+  GlideAnimationInfo *animation_info;
   
   CoglHandle background_material;
   
   ClutterActor *contents_group;
   
   ClutterColor color;
+  
+  /* Set until the actors are built from it, see glide_slide_materialize */
+  JsonObject *pending_json;
+  gfloat pending_width, pending_height;
+  /* Building from pending_json changes nothing which is saved */
+  gboolean materializing;
+  
+  /* What glide_slide_serialize last returned, dropped when the slide changes */
+  JsonNode *serialized;
 };
 
 G_END_DECLS
@@ -0,0 +1,57 @@
+/*
+ * glide-slide-sorter-priv.h
+ * This file is part of glide
+ *
+ * Copyright (C) 2010 - Robert Carr
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANACTORILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, 
+ * Boston, MA 02111-1307, USA.
+ */
+ 
+#ifndef __GLIDE_SLIDE_SORTER_PRIVATE_H__
+#define __GLIDE_SLIDE_SORTER_PRIVATE_H__
+
+#include "glide-slide-sorter.h"
+
+G_BEGIN_DECLS
+
+struct _GlideSlideSorterPrivate
+{
+  GlideStageManager *manager;
+  GlideDocument *document;
+  
+  GtkListStore *store;
+  /* The row of each slide, plus one, as of the last sync */
+  GHashTable *rows;
+  gint thumbnail_width, thumbnail_height;
+  
+  /* Checksums of the slides drawn so far, and of those since edited */
+  GHashTable *checksums;
+  GHashTable *stale_checksums;
+  
+  GQueue render_queue;
+  GHashTable *queued;
+  /* Slides being looked for on disk, and those found on neither */
+  GHashTable *loading;
+  GHashTable *missed;
+  guint render_id;
+  guint sync_id;
+  
+  gboolean updating_cursor;
+};
+
+G_END_DECLS
+
+#endif  /* __GLIDE_SLIDE_SORTER_PRIVATE_H__  */
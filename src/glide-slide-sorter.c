@@ -0,0 +1,652 @@
+/*
+ * glide-slide-sorter.c
+ * This file is part of glide
+ *
+ * Copyright (C) 2010 - Robert Carr
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, 
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "glide-slide-sorter.h"
+#include "glide-slide-sorter-priv.h"
+
+#include "glide-document.h"
+#include "glide-thumbnail-cache.h"
+
+#include "glide-debug.h"
+
+G_DEFINE_TYPE(GlideSlideSorter, glide_slide_sorter, GTK_TYPE_TREE_VIEW)
+
+#define GLIDE_SLIDE_SORTER_GET_PRIVATE(object)(G_TYPE_INSTANCE_GET_PRIVATE ((object), GLIDE_TYPE_SLIDE_SORTER, GlideSlideSorterPrivate))
+
+#define THUMBNAIL_WIDTH 128
+#define THUMBNAIL_PADDING 4
+
+enum {
+  COLUMN_SLIDE,
+  N_COLUMNS
+};
+
+enum {
+  PROP_0,
+  PROP_STAGE_MANAGER
+};
+
+static void glide_slide_sorter_disconnect (GlideSlideSorter *sorter);
+
+static gboolean
+glide_slide_sorter_find_slide (GlideSlideSorter *sorter, GlideSlide *slide, GtkTreeIter *iter)
+{
+  guint row = GPOINTER_TO_UINT (g_hash_table_lookup (sorter->priv->rows, slide));
+  
+  // Rows are out of date until the pending sync, which redraws them all.
+  if (!row || sorter->priv->sync_id)
+    return FALSE;
+  
+  return gtk_tree_model_iter_nth_child (GTK_TREE_MODEL (sorter->priv->store), iter, NULL, row - 1);
+}
+
+static void
+glide_slide_sorter_row_changed (GlideSlideSorter *sorter, GlideSlide *slide)
+{
+  GtkTreeModel *model = GTK_TREE_MODEL (sorter->priv->store);
+  GtkTreePath *path;
+  GtkTreeIter iter;
+  
+  if (!glide_slide_sorter_find_slide (sorter, slide, &iter))
+    return;
+  
+  path = gtk_tree_model_get_path (model, &iter);
+  gtk_tree_model_row_changed (model, path, &iter);
+  gtk_tree_path_free (path);
+}
+
+static const gchar *
+glide_slide_sorter_get_checksum (GlideSlideSorter *sorter, GlideSlide *slide)
+{
+  gchar *checksum = g_hash_table_lookup (sorter->priv->checksums, slide);
+  
+  if (!checksum)
+    {
+      checksum = glide_slide_get_checksum (slide);
+      g_hash_table_insert (sorter->priv->checksums, slide, checksum);
+    }
+  return checksum;
+}
+
+static void glide_slide_sorter_queue_render (GlideSlideSorter *sorter, GlideSlide *slide);
+
+typedef struct _GlideSlideSorterLoad {
+  GlideSlideSorter *sorter;
+  GlideSlide *slide;
+} GlideSlideSorterLoad;
+
+static void
+glide_slide_sorter_loaded_cb (GdkPixbuf *pixbuf, gpointer user_data)
+{
+  GlideSlideSorterLoad *load = (GlideSlideSorterLoad *)user_data;
+  GlideSlideSorter *sorter = load->sorter;
+  
+  if (sorter)
+    {
+      g_object_remove_weak_pointer (G_OBJECT (sorter), (gpointer *)&load->sorter);
+      g_hash_table_remove (sorter->priv->loading, load->slide);
+      
+      if (pixbuf)
+	{
+	  g_hash_table_remove (sorter->priv->stale_checksums, load->slide);
+	  glide_slide_sorter_row_changed (sorter, load->slide);
+	}
+      else
+	{
+	  g_hash_table_insert (sorter->priv->missed, load->slide, load->slide);
+	  glide_slide_sorter_queue_render (sorter, load->slide);
+	}
+    }
+  
+  g_object_unref (load->slide);
+  g_slice_free (GlideSlideSorterLoad, load);
+}
+
+/*
+ * Handles one slide per iteration, so editing stays responsive: looks
+ * for its thumbnail on disk from a thread, and renders it only if that
+ * misses too.
+ */
+static gboolean
+glide_slide_sorter_render_idle (gpointer user_data)
+{
+  GlideSlideSorter *sorter = (GlideSlideSorter *)user_data;
+  GlideSlideSorterPrivate *priv = sorter->priv;
+  GlideSlide *slide = g_queue_pop_head (&priv->render_queue);
+  GtkTreeIter iter;
+  
+  if (slide)
+    g_hash_table_remove (priv->queued, slide);
+  if (slide && !g_hash_table_lookup (priv->loading, slide) &&
+      !g_hash_table_lookup (priv->missed, slide) &&
+      glide_slide_sorter_find_slide (sorter, slide, &iter))
+    {
+      GlideSlideSorterLoad *load = g_slice_new (GlideSlideSorterLoad);
+      
+      load->sorter = sorter;
+      load->slide = g_object_ref (slide);
+      g_object_add_weak_pointer (G_OBJECT (sorter), (gpointer *)&load->sorter);
+      
+      g_hash_table_insert (priv->loading, slide, slide);
+      glide_thumbnail_cache_load (glide_slide_sorter_get_checksum (sorter, slide),
+				  priv->thumbnail_width, priv->thumbnail_height,
+				  glide_slide_sorter_loaded_cb, load);
+    }
+  else if (slide && g_hash_table_remove (priv->missed, slide) &&
+	   glide_slide_sorter_find_slide (sorter, slide, &iter))
+    {
+      GdkPixbuf *pixbuf;
+      
+      pixbuf = glide_thumbnail_cache_get (slide, glide_slide_sorter_get_checksum (sorter, slide),
+					  priv->thumbnail_width, priv->thumbnail_height);
+      if (pixbuf)
+	{
+	  g_object_unref (pixbuf);
+	  
+	  g_hash_table_remove (priv->stale_checksums, slide);
+	  glide_slide_sorter_row_changed (sorter, slide);
+	}
+    }
+  if (slide)
+    g_object_unref (slide);
+  
+  if (g_queue_is_empty (&priv->render_queue))
+    {
+      priv->render_id = 0;
+      return FALSE;
+    }
+  return TRUE;
+}
+
+static void
+glide_slide_sorter_queue_render (GlideSlideSorter *sorter, GlideSlide *slide)
+{
+  GlideSlideSorterPrivate *priv = sorter->priv;
+  
+  if (g_hash_table_lookup (priv->queued, slide))
+    return;
+  
+  g_hash_table_insert (priv->queued, slide, slide);
+  g_queue_push_tail (&priv->render_queue, g_object_ref (slide));
+  if (!priv->render_id)
+    priv->render_id = g_idle_add_full (G_PRIORITY_LOW, glide_slide_sorter_render_idle,
+				       sorter, NULL);
+}
+
+static void
+glide_slide_sorter_clear_render_queue (GlideSlideSorter *sorter)
+{
+  GlideSlide *slide;
+  
+  while ((slide = g_queue_pop_head (&sorter->priv->render_queue)))
+    g_object_unref (slide);
+  g_hash_table_remove_all (sorter->priv->queued);
+  g_hash_table_remove_all (sorter->priv->missed);
+  
+  if (sorter->priv->render_id)
+    {
+      g_source_remove (sorter->priv->render_id);
+      sorter->priv->render_id = 0;
+    }
+}
+
+/*
+ * Only called for rows GTK is about to draw, which is what keeps large
+ * decks cheap: thumbnails for the rest are never looked at. Misses
+ * show the thumbnail from before the last edit, if any, until the new
+ * one is rendered.
+ */
+static void
+glide_slide_sorter_thumbnail_data_func (GtkTreeViewColumn *column,
+					GtkCellRenderer *cell,
+					GtkTreeModel *model,
+					GtkTreeIter *iter,
+					gpointer user_data)
+{
+  GlideSlideSorter *sorter = (GlideSlideSorter *)user_data;
+  GlideSlideSorterPrivate *priv = sorter->priv;
+  GdkPixbuf *pixbuf;
+  GlideSlide *slide;
+  
+  gtk_tree_model_get (model, iter, COLUMN_SLIDE, &slide, -1);
+  if (!slide)
+    return;
+  
+  pixbuf = glide_thumbnail_cache_lookup (glide_slide_sorter_get_checksum (sorter, slide),
+					 priv->thumbnail_width, priv->thumbnail_height);
+  if (!pixbuf)
+    {
+      const gchar *stale = g_hash_table_lookup (priv->stale_checksums, slide);
+      
+      glide_slide_sorter_queue_render (sorter, slide);
+      if (stale)
+	pixbuf = glide_thumbnail_cache_lookup (stale, priv->thumbnail_width,
+					       priv->thumbnail_height);
+    }
+  
+  g_object_set (cell, "pixbuf", pixbuf, NULL);
+  
+  if (pixbuf)
+    g_object_unref (pixbuf);
+  g_object_unref (slide);
+}
+
+static void
+glide_slide_sorter_number_data_func (GtkTreeViewColumn *column,
+				     GtkCellRenderer *cell,
+				     GtkTreeModel *model,
+				     GtkTreeIter *iter,
+				     gpointer user_data)
+{
+  GtkTreePath *path = gtk_tree_model_get_path (model, iter);
+  gchar *number = g_strdup_printf ("%d", gtk_tree_path_get_indices (path)[0] + 1);
+  
+  g_object_set (cell, "text", number, NULL);
+  
+  g_free (number);
+  gtk_tree_path_free (path);
+}
+
+static void
+glide_slide_sorter_update_cursor (GlideSlideSorter *sorter)
+{
+  GlideSlideSorterPrivate *priv = sorter->priv;
+  GtkTreePath *path;
+  gint current;
+  
+  current = glide_stage_manager_get_current_slide (priv->manager);
+  if (current < 0 || current >= gtk_tree_model_iter_n_children (GTK_TREE_MODEL (priv->store), NULL))
+    return;
+  
+  path = gtk_tree_path_new_from_indices (current, -1);
+  
+  priv->updating_cursor = TRUE;
+  gtk_tree_view_set_cursor (GTK_TREE_VIEW (sorter), path, NULL, FALSE);
+  priv->updating_cursor = FALSE;
+  
+  gtk_tree_path_free (path);
+}
+
+static void
+glide_slide_sorter_update_size (GlideSlideSorter *sorter)
+{
+  GlideSlideSorterPrivate *priv = sorter->priv;
+  GtkTreeViewColumn *column = gtk_tree_view_get_column (GTK_TREE_VIEW (sorter), 1);
+  GList *cells = gtk_tree_view_column_get_cell_renderers (column);
+  gint width, height;
+  
+  glide_document_get_size (priv->document, &width, &height);
+  
+  priv->thumbnail_width = THUMBNAIL_WIDTH;
+  priv->thumbnail_height = MAX (THUMBNAIL_WIDTH * height / MAX (width, 1), 1);
+  
+  gtk_cell_renderer_set_fixed_size (GTK_CELL_RENDERER (cells->data),
+				    priv->thumbnail_width + 2 * THUMBNAIL_PADDING,
+				    priv->thumbnail_height + 2 * THUMBNAIL_PADDING);
+  g_list_free (cells);
+  
+  gtk_widget_queue_resize (GTK_WIDGET (sorter));
+}
+
+/* Rebuilds the rows, once per batch of added or removed slides */
+static gboolean
+glide_slide_sorter_sync_idle (gpointer user_data)
+{
+  GlideSlideSorter *sorter = (GlideSlideSorter *)user_data;
+  GlideSlideSorterPrivate *priv = sorter->priv;
+  guint i, n_slides;
+  
+  priv->sync_id = 0;
+  
+  gtk_tree_view_set_model (GTK_TREE_VIEW (sorter), NULL);
+  gtk_list_store_clear (priv->store);
+  g_hash_table_remove_all (priv->rows);
+  
+  n_slides = priv->document ? glide_document_get_n_slides (priv->document) : 0;
+  for (i = 0; i < n_slides; i++)
+    {
+      GlideSlide *slide = glide_document_get_nth_slide (priv->document, i);
+      
+      gtk_list_store_insert_with_values (priv->store, NULL, i, COLUMN_SLIDE, slide, -1);
+      g_hash_table_insert (priv->rows, slide, GUINT_TO_POINTER (i + 1));
+    }
+  
+  gtk_tree_view_set_model (GTK_TREE_VIEW (sorter), GTK_TREE_MODEL (priv->store));
+  
+  GLIDE_NOTE (WINDOW, "Slide sorter holds %u slides", n_slides);
+  
+  if (priv->manager)
+    glide_slide_sorter_update_cursor (sorter);
+  
+  return FALSE;
+}
+
+static void
+glide_slide_sorter_queue_sync (GlideSlideSorter *sorter)
+{
+  if (!sorter->priv->sync_id)
+    sorter->priv->sync_id = g_idle_add_full (G_PRIORITY_HIGH_IDLE, glide_slide_sorter_sync_idle,
+					     sorter, NULL);
+}
+
+static void
+glide_slide_sorter_slide_added_cb (GlideDocument *document,
+				   GlideSlide *slide,
+				   gpointer user_data)
+{
+  glide_slide_sorter_queue_sync (GLIDE_SLIDE_SORTER (user_data));
+}
+
+static void
+glide_slide_sorter_slide_removed_cb (GlideDocument *document,
+				     GlideSlide *slide,
+				     gpointer user_data)
+{
+  GlideSlideSorter *sorter = GLIDE_SLIDE_SORTER (user_data);
+  
+  g_hash_table_remove (sorter->priv->checksums, slide);
+  g_hash_table_remove (sorter->priv->stale_checksums, slide);
+  
+  glide_slide_sorter_queue_sync (sorter);
+}
+
+static void
+glide_slide_sorter_resized_cb (GlideDocument *document,
+			       gpointer user_data)
+{
+  GlideSlideSorter *sorter = GLIDE_SLIDE_SORTER (user_data);
+  
+  // Resizing moves every actor, so all the checksums change.
+  g_hash_table_remove_all (sorter->priv->checksums);
+  glide_slide_sorter_update_size (sorter);
+}
+
+/*
+ * Whichever slide was edited, its thumbnail is rendered again in the
+ * background if it was ever shown, and the others are untouched.
+ */
+static void
+glide_slide_sorter_slide_changed_cb (GlideDocument *document,
+				     GlideSlide *slide,
+				     gpointer user_data)
+{
+  GlideSlideSorter *sorter = GLIDE_SLIDE_SORTER (user_data);
+  GlideSlideSorterPrivate *priv = sorter->priv;
+  gchar *checksum = g_hash_table_lookup (priv->checksums, slide);
+  
+  if (!checksum)
+    return;
+  
+  g_hash_table_steal (priv->checksums, slide);
+  g_hash_table_replace (priv->stale_checksums, slide, checksum);
+  
+  glide_slide_sorter_row_changed (sorter, slide);
+}
+
+static void
+glide_slide_sorter_current_slide_cb (GObject *object,
+				     GParamSpec *pspec,
+				     gpointer user_data)
+{
+  glide_slide_sorter_update_cursor (GLIDE_SLIDE_SORTER (user_data));
+}
+
+static void
+glide_slide_sorter_cursor_changed (GtkTreeView *tree_view,
+				   gpointer user_data)
+{
+  GlideSlideSorter *sorter = GLIDE_SLIDE_SORTER (tree_view);
+  GtkTreePath *path;
+  gint index;
+  
+  if (sorter->priv->updating_cursor || !sorter->priv->manager)
+    return;
+  
+  gtk_tree_view_get_cursor (tree_view, &path, NULL);
+  if (!path)
+    return;
+  
+  index = gtk_tree_path_get_indices (path)[0];
+  if (index != glide_stage_manager_get_current_slide (sorter->priv->manager))
+    glide_stage_manager_set_current_slide (sorter->priv->manager, index);
+  
+  gtk_tree_path_free (path);
+}
+
+static void
+glide_slide_sorter_disconnect (GlideSlideSorter *sorter)
+{
+  GlideSlideSorterPrivate *priv = sorter->priv;
+  
+  glide_slide_sorter_clear_render_queue (sorter);
+  if (priv->sync_id)
+    {
+      g_source_remove (priv->sync_id);
+      priv->sync_id = 0;
+    }
+  
+  g_hash_table_remove_all (priv->checksums);
+  g_hash_table_remove_all (priv->stale_checksums);
+  
+  if (priv->document)
+    {
+      g_signal_handlers_disconnect_by_func (priv->document, glide_slide_sorter_slide_added_cb, sorter);
+      g_signal_handlers_disconnect_by_func (priv->document, glide_slide_sorter_slide_removed_cb, sorter);
+      g_signal_handlers_disconnect_by_func (priv->document, glide_slide_sorter_resized_cb, sorter);
+      g_signal_handlers_disconnect_by_func (priv->document, glide_slide_sorter_slide_changed_cb, sorter);
+      g_object_unref (priv->document);
+      priv->document = NULL;
+    }
+  if (priv->manager)
+    {
+      g_signal_handlers_disconnect_by_func (priv->manager, glide_slide_sorter_current_slide_cb, sorter);
+      g_object_unref (priv->manager);
+      priv->manager = NULL;
+    }
+  
+  gtk_list_store_clear (priv->store);
+  g_hash_table_remove_all (priv->rows);
+}
+
+static void
+glide_slide_sorter_dispose (GObject *object)
+{
+  GlideSlideSorter *sorter = GLIDE_SLIDE_SORTER (object);
+  
+  if (sorter->priv->store)
+    {
+      glide_slide_sorter_disconnect (sorter);
+      
+      g_object_unref (sorter->priv->store);
+      sorter->priv->store = NULL;
+    }
+  
+  G_OBJECT_CLASS (glide_slide_sorter_parent_class)->dispose (object);
+}
+
+static void
+glide_slide_sorter_finalize (GObject *object)
+{
+  GlideSlideSorter *sorter = GLIDE_SLIDE_SORTER (object);
+  
+  g_hash_table_destroy (sorter->priv->checksums);
+  g_hash_table_destroy (sorter->priv->stale_checksums);
+  g_hash_table_destroy (sorter->priv->rows);
+  g_hash_table_destroy (sorter->priv->queued);
+  g_hash_table_destroy (sorter->priv->loading);
+  g_hash_table_destroy (sorter->priv->missed);
+  
+  G_OBJECT_CLASS (glide_slide_sorter_parent_class)->finalize (object);
+}
+
+static void
+glide_slide_sorter_get_property (GObject *object,
+				 guint prop_id,
+				 GValue *value,
+				 GParamSpec *pspec)
+{
+  GlideSlideSorter *sorter = GLIDE_SLIDE_SORTER (object);
+  
+  switch (prop_id)
+    {
+    case PROP_STAGE_MANAGER:
+      g_value_set_object (value, sorter->priv->manager);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+    }
+}
+
+static void
+glide_slide_sorter_set_property (GObject *object,
+				 guint prop_id,
+				 const GValue *value,
+				 GParamSpec *pspec)
+{
+  GlideSlideSorter *sorter = GLIDE_SLIDE_SORTER (object);
+  
+  switch (prop_id)
+    {
+    case PROP_STAGE_MANAGER:
+      glide_slide_sorter_set_stage_manager (sorter, g_value_get_object (value));
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+    }
+}
+
+static void
+glide_slide_sorter_class_init (GlideSlideSorterClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  
+  object_class->dispose = glide_slide_sorter_dispose;
+  object_class->finalize = glide_slide_sorter_finalize;
+  object_class->get_property = glide_slide_sorter_get_property;
+  object_class->set_property = glide_slide_sorter_set_property;
+  
+  g_object_class_install_property (object_class,
+				   PROP_STAGE_MANAGER,
+				   g_param_spec_object ("stage-manager",
+							"Stage manager",
+							"The stage manager whose document is shown",
+							GLIDE_TYPE_STAGE_MANAGER,
+							G_PARAM_READWRITE |
+							G_PARAM_STATIC_STRINGS));
+  
+  g_type_class_add_private (object_class, sizeof(GlideSlideSorterPrivate));
+}
+
+static void
+glide_slide_sorter_init (GlideSlideSorter *sorter)
+{
+  GtkTreeView *tree_view = GTK_TREE_VIEW (sorter);
+  GtkTreeViewColumn *column;
+  GtkCellRenderer *cell;
+  
+  sorter->priv = GLIDE_SLIDE_SORTER_GET_PRIVATE (sorter);
+  
+  sorter->priv->store = gtk_list_store_new (N_COLUMNS, GLIDE_TYPE_SLIDE);
+  sorter->priv->checksums = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
+  sorter->priv->stale_checksums = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
+  sorter->priv->rows = g_hash_table_new (NULL, NULL);
+  sorter->priv->queued = g_hash_table_new (NULL, NULL);
+  sorter->priv->loading = g_hash_table_new (NULL, NULL);
+  sorter->priv->missed = g_hash_table_new (NULL, NULL);
+  sorter->priv->thumbnail_width = THUMBNAIL_WIDTH;
+  sorter->priv->thumbnail_height = THUMBNAIL_WIDTH * 3 / 4;
+  
+  gtk_tree_view_set_model (tree_view, GTK_TREE_MODEL (sorter->priv->store));
+  gtk_tree_view_set_headers_visible (tree_view, FALSE);
+  
+  cell = gtk_cell_renderer_text_new ();
+  g_object_set (cell, "yalign", 0.0, NULL);
+  column = gtk_tree_view_column_new_with_attributes ("Number", cell, NULL);
+  gtk_tree_view_column_set_cell_data_func (column, cell, glide_slide_sorter_number_data_func,
+					   sorter, NULL);
+  gtk_tree_view_column_set_sizing (column, GTK_TREE_VIEW_COLUMN_FIXED);
+  gtk_tree_view_column_set_fixed_width (column, 32);
+  gtk_tree_view_append_column (tree_view, column);
+  
+  cell = gtk_cell_renderer_pixbuf_new ();
+  column = gtk_tree_view_column_new_with_attributes ("Slide", cell, NULL);
+  gtk_tree_view_column_set_cell_data_func (column, cell, glide_slide_sorter_thumbnail_data_func,
+					   sorter, NULL);
+  gtk_tree_view_column_set_sizing (column, GTK_TREE_VIEW_COLUMN_FIXED);
+  gtk_tree_view_column_set_fixed_width (column, THUMBNAIL_WIDTH + 2 * THUMBNAIL_PADDING);
+  gtk_cell_renderer_set_fixed_size (cell, THUMBNAIL_WIDTH + 2 * THUMBNAIL_PADDING,
+				    sorter->priv->thumbnail_height + 2 * THUMBNAIL_PADDING);
+  gtk_tree_view_append_column (tree_view, column);
+  
+  // Rows are never measured one by one, so only visible ones are drawn.
+  gtk_tree_view_set_fixed_height_mode (tree_view, TRUE);
+  
+  g_signal_connect (sorter, "cursor-changed", G_CALLBACK (glide_slide_sorter_cursor_changed), NULL);
+}
+
+GtkWidget *
+glide_slide_sorter_new (void)
+{
+  return g_object_new (GLIDE_TYPE_SLIDE_SORTER, NULL);
+}
+
+void
+glide_slide_sorter_set_stage_manager (GlideSlideSorter *sorter,
+				      GlideStageManager *manager)
+{
+  GlideSlideSorterPrivate *priv = sorter->priv;
+  
+  if (manager == priv->manager)
+    return;
+  
+  glide_slide_sorter_disconnect (sorter);
+  
+  if (manager)
+    {
+      priv->manager = g_object_ref (manager);
+      priv->document = g_object_ref (glide_stage_manager_get_document (manager));
+      
+      g_signal_connect (priv->document, "slide-added",
+			G_CALLBACK (glide_slide_sorter_slide_added_cb), sorter);
+      g_signal_connect (priv->document, "slide-removed",
+			G_CALLBACK (glide_slide_sorter_slide_removed_cb), sorter);
+      g_signal_connect (priv->document, "resized",
+			G_CALLBACK (glide_slide_sorter_resized_cb), sorter);
+      g_signal_connect (priv->document, "slide-changed",
+			G_CALLBACK (glide_slide_sorter_slide_changed_cb), sorter);
+      g_signal_connect (priv->manager, "notify::current-slide",
+			G_CALLBACK (glide_slide_sorter_current_slide_cb), sorter);
+      
+      glide_slide_sorter_update_size (sorter);
+      glide_slide_sorter_queue_sync (sorter);
+    }
+  
+  g_object_notify (G_OBJECT (sorter), "stage-manager");
+}
+
+GlideStageManager *
+glide_slide_sorter_get_stage_manager (GlideSlideSorter *sorter)
+{
+  return sorter->priv->manager;
+}
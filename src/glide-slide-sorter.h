@@ -0,0 +1,80 @@
+/*
+ * glide-slide-sorter.h
+ * This file is part of glide
+ *
+ * Copyright (C) 2010 - Robert Carr
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, 
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GLIDE_SLIDE_SORTER_H__
+#define __GLIDE_SLIDE_SORTER_H__
+
+#include <gtk/gtk.h>
+
+#include "glide-stage-manager.h"
+#include "glide-slide.h"
+
+G_BEGIN_DECLS
+
+/*
+ * Type checking and casting macros
+ */
+#define GLIDE_TYPE_SLIDE_SORTER              (glide_slide_sorter_get_type())
+#define GLIDE_SLIDE_SORTER(obj)              (G_TYPE_CHECK_INSTANCE_CAST((obj), GLIDE_TYPE_SLIDE_SORTER, GlideSlideSorter))
+#define GLIDE_SLIDE_SORTER_CLASS(klass)      (G_TYPE_CHECK_CLASS_CAST((klass), GLIDE_TYPE_SLIDE_SORTER, GlideSlideSorterClass))
+#define GLIDE_IS_SLIDE_SORTER(obj)           (G_TYPE_CHECK_INSTANCE_TYPE((obj), GLIDE_TYPE_SLIDE_SORTER))
+#define GLIDE_IS_SLIDE_SORTER_CLASS(klass)   (G_TYPE_CHECK_CLASS_TYPE ((klass), GLIDE_TYPE_SLIDE_SORTER))
+#define GLIDE_SLIDE_SORTER_GET_CLASS(obj)    (G_TYPE_INSTANCE_GET_CLASS((obj), GLIDE_TYPE_SLIDE_SORTER, GlideSlideSorterClass))
+
+/* Private structure type */
+typedef struct _GlideSlideSorterPrivate GlideSlideSorterPrivate;
+
+/*
+ * Main object structure
+ */
+typedef struct _GlideSlideSorter GlideSlideSorter;
+
+struct _GlideSlideSorter 
+{
+  GtkTreeView tree_view;
+  
+  GlideSlideSorterPrivate *priv;
+};
+
+/*
+ * Class definition
+ */
+typedef struct _GlideSlideSorterClass GlideSlideSorterClass;
+
+struct _GlideSlideSorterClass 
+{
+  GtkTreeViewClass parent_class;
+};
+
+/*
+ * Public methods
+ */
+GType glide_slide_sorter_get_type (void) G_GNUC_CONST;
+
+GtkWidget *glide_slide_sorter_new (void);
+
+void glide_slide_sorter_set_stage_manager (GlideSlideSorter *sorter, GlideStageManager *manager);
+GlideStageManager *glide_slide_sorter_get_stage_manager (GlideSlideSorter *sorter);
+
+G_END_DECLS
+
+#endif  /* __GLIDE_SLIDE_SORTER_H__  */
@@ -20,17 +20,25 @@
  * Boston, MA 02111-1307, USA.
  */
 #include <math.h>
+#include <sys/stat.h>
+
+#include <glib/gstdio.h>
 
 #include "glide-slide.h"
 #include "glide-slide-priv.h"
 
+#include "glide-document.h"
+
 #include "glide-text.h"
+#include "glide-image.h"
 
 #include "glide-json-util.h"
+#include "glide-texture-cache.h"
 
 #include "glide-debug.h"
 
 static void clutter_container_iface_init (ClutterContainerIface *iface);
+static void glide_slide_scale_contents (GlideSlide *slide, gfloat rx, gfloat ry, gfloat width);
 
 G_DEFINE_TYPE_WITH_CODE (GlideSlide, glide_slide, GLIDE_TYPE_ACTOR,
 	 G_IMPLEMENT_INTERFACE (CLUTTER_TYPE_CONTAINER,
@@ -437,6 +445,17 @@ glide_slide_dispose (GObject *object)
   if (priv->background_material)
     {
       cogl_handle_unref (priv->background_material);
+      priv->background_material = NULL;
+    }
+  if (priv->pending_json)
+    {
+      json_object_unref (priv->pending_json);
+      priv->pending_json = NULL;
+    }
+  if (priv->serialized)
+    {
+      json_node_free (priv->serialized);
+      priv->serialized = NULL;
     }
   
   //  g_free (priv->background);
@@ -457,6 +476,8 @@ glide_slide_json_obj_set_actors (GlideSlide *slide, JsonObject *obj)
       GlideActor *actor = (GlideActor *)(s->data);
       JsonNode *n;
       
+      if (!GLIDE_IS_ACTOR (actor))
+	continue;
       n = glide_actor_serialize (actor);
       if (n)
 	json_array_add_element (array, n);
@@ -465,25 +486,125 @@ glide_slide_json_obj_set_actors (GlideSlide *slide, JsonObject *obj)
   json_object_set_member (obj, "actors", node);			
 }
 
+/*
+ * The actors of a slide which was never built, as though they had been
+ * built and scaled by rx, ry. Only the geometry and fonts change, the
+ * text layouts are fitted again once the slide is built.
+ */
+static JsonNode *
+glide_slide_scale_pending_actors (JsonArray *actors, gdouble rx, gdouble ry)
+{
+  JsonArray *scaled = json_array_sized_new (json_array_get_length (actors));
+  JsonNode *node = json_node_new (JSON_NODE_ARRAY);
+  guint i;
+  
+  for (i = 0; i < json_array_get_length (actors); i++)
+    {
+      JsonObject *actor_obj = json_array_get_object_element (actors, i);
+      JsonObject *obj = json_object_new ();
+      JsonNode *n = json_node_new (JSON_NODE_OBJECT);
+      GList *members, *m;
+      gdouble x, y, width, height;
+      
+      members = json_object_get_members (actor_obj);
+      for (m = members; m; m = m->next)
+	json_object_set_member (obj, m->data,
+				json_node_copy (json_object_get_member (actor_obj, m->data)));
+      g_list_free (members);
+      
+      if (glide_json_object_get_geometry (actor_obj, &x, &y, &width, &height))
+	glide_json_object_set_geometry (obj, round (x * rx), round (y * ry),
+					width * rx, height * ry);
+      
+      if (json_object_has_member (actor_obj, "text-properties"))
+	{
+	  JsonObject *props = json_object_get_object_member (actor_obj, "text-properties");
+	  JsonObject *scaled_props = json_object_new ();
+	  JsonNode *props_n = json_node_new (JSON_NODE_OBJECT);
+	  const gchar *font_name = glide_json_object_get_string (props, "font-name");
+	  
+	  members = json_object_get_members (props);
+	  for (m = members; m; m = m->next)
+	    json_object_set_member (scaled_props, m->data,
+				    json_node_copy (json_object_get_member (props, m->data)));
+	  g_list_free (members);
+	  
+	  if (font_name)
+	    {
+	      PangoFontDescription *desc = pango_font_description_from_string (font_name);
+	      gdouble size = pango_font_description_get_size (desc) / (gdouble) PANGO_SCALE;
+	      gchar *scaled_name;
+	      
+	      pango_font_description_set_size (desc, round (ry * size) * PANGO_SCALE);
+	      scaled_name = pango_font_description_to_string (desc);
+	      glide_json_object_set_string (scaled_props, "font-name", scaled_name);
+	      
+	      g_free (scaled_name);
+	      pango_font_description_free (desc);
+	    }
+	  
+	  json_node_take_object (props_n, scaled_props);
+	  json_object_set_member (obj, "text-properties", props_n);
+	}
+      
+      json_node_take_object (n, obj);
+      json_array_add_element (scaled, n);
+    }
+  
+  json_node_take_array (node, scaled);
+  
+  return node;
+}
+
 static JsonNode *
 glide_slide_serialize (GlideActor *self)
 {
   GlideSlide *slide = GLIDE_SLIDE (self);
-  JsonNode *node = json_node_new (JSON_NODE_OBJECT);
+  JsonNode *node;
   JsonObject *obj;
+  const gchar *background, *animation;
+  
+  // Copying a node only references its object, so this is cheap.
+  if (slide->priv->serialized)
+    return json_node_copy (slide->priv->serialized);
   
+  GLIDE_NOTE (DOCUMENT, "Serializing slide %p", slide);
+  
+  node = json_node_new (JSON_NODE_OBJECT);
   obj = json_object_new ();
   json_node_set_object (node, obj);
   
-  glide_slide_json_obj_set_actors (slide, obj);
+  // Never built, so the actors are what we loaded, scaled if the
+  // document was resized since.
+  if (slide->priv->pending_json)
+    {
+      JsonNode *actors = json_object_get_member (slide->priv->pending_json, "actors");
+      gfloat width, height;
+      
+      clutter_actor_get_size (CLUTTER_ACTOR (slide), &width, &height);
+      if (actors && JSON_NODE_TYPE (actors) == JSON_NODE_ARRAY &&
+	  (width != slide->priv->pending_width || height != slide->priv->pending_height))
+	json_object_set_member (obj, "actors",
+				glide_slide_scale_pending_actors (json_node_get_array (actors),
+								  width / slide->priv->pending_width,
+								  height / slide->priv->pending_height));
+      else if (actors)
+	json_object_set_member (obj, "actors", json_node_copy (actors));
+    }
+  else
+    glide_slide_json_obj_set_actors (slide, obj);
   
-  if (slide->priv->background)
-    glide_json_object_set_string (obj, "background", slide->priv->background); 
-  if (slide->priv->animation)
-    glide_json_object_set_string (obj, "animation", slide->priv->animation); 
+  background = glide_slide_get_background (slide);
+  if (background)
+    glide_json_object_set_string (obj, "background", background); 
+  animation = glide_slide_get_animation (slide);
+  if (animation)
+    glide_json_object_set_string (obj, "animation", animation); 
   else
     glide_json_object_set_string (obj, "animation", "None"); 
   
+  slide->priv->serialized = json_node_copy (node);
+  
   return node;
 }
 
@@ -550,6 +671,16 @@ glide_slide_class_init (GlideSlideClass *klass)
   g_type_class_add_private (object_class, sizeof(GlideSlidePrivate));
 }
 
+static void
+glide_slide_contents_changed (ClutterContainer *container,
+			      ClutterActor *actor,
+			      gpointer user_data)
+{
+  // The stage manager moves its manipulator between slides as they are shown.
+  if (GLIDE_IS_ACTOR (actor))
+    glide_slide_mark_dirty (GLIDE_SLIDE (user_data));
+}
+
 static void
 glide_slide_init (GlideSlide *self)
 {
@@ -561,6 +692,11 @@ glide_slide_init (GlideSlide *self)
   self->priv->contents_group = clutter_group_new ();
   clutter_container_add_actor (CLUTTER_CONTAINER (self), self->priv->contents_group);
   
+  g_signal_connect (self->priv->contents_group, "actor-added",
+		    G_CALLBACK (glide_slide_contents_changed), self);
+  g_signal_connect (self->priv->contents_group, "actor-removed",
+		    G_CALLBACK (glide_slide_contents_changed), self);
+  
   CLUTTER_ACTOR_SET_FLAGS (self, CLUTTER_ACTOR_NO_LAYOUT);
 }
 
@@ -611,26 +747,132 @@ glide_slide_construct_from_json (GlideSlide *slide, JsonObject *slide_obj, Glide
     }
 }
 
+void
+glide_slide_construct_from_json_deferred (GlideSlide *slide, JsonObject *slide_obj)
+{
+  const gchar *animation;
+  
+  // Set directly, glide_slide_set_animation would build the slide and
+  // mark it dirty a second time.
+  animation = glide_json_object_get_string (slide_obj, "animation");
+  if (animation)
+    {
+      g_free (slide->priv->animation);
+      slide->priv->animation = g_strdup (animation);
+      slide->priv->animation_info = glide_animations_lookup (animation);
+      g_object_notify (G_OBJECT (slide), "animation");
+    }
+  
+  if (slide->priv->pending_json)
+    json_object_unref (slide->priv->pending_json);
+  slide->priv->pending_json = json_object_ref (slide_obj);
+  glide_slide_mark_dirty (slide);
+  
+  clutter_actor_get_size (CLUTTER_ACTOR (slide), &slide->priv->pending_width,
+			  &slide->priv->pending_height);
+}
+
+/*
+ * Throws away the actors and background of the slide, and loads it
+ * again from slide_obj as though it had never been shown.
+ */
+void
+glide_slide_replace_from_json (GlideSlide *slide, JsonObject *slide_obj)
+{
+  gboolean materialized = glide_slide_get_materialized (slide);
+  GList *children, *a;
+  
+  // Leaves the stage manager's manipulator where it is.
+  children = clutter_container_get_children (CLUTTER_CONTAINER (slide->priv->contents_group));
+  for (a = children; a; a = a->next)
+    if (GLIDE_IS_ACTOR (a->data))
+      clutter_container_remove_actor (CLUTTER_CONTAINER (slide->priv->contents_group),
+				      CLUTTER_ACTOR (a->data));
+  g_list_free (children);
+  
+  g_free (slide->priv->background);
+  slide->priv->background = NULL;
+  if (slide->priv->background_material)
+    {
+      cogl_handle_unref (slide->priv->background_material);
+      slide->priv->background_material = NULL;
+    }
+  
+  glide_slide_construct_from_json_deferred (slide, slide_obj);
+  if (materialized)
+    glide_slide_materialize (slide);
+  
+  clutter_actor_queue_redraw (CLUTTER_ACTOR (slide));
+}
+
+gboolean
+glide_slide_get_materialized (GlideSlide *slide)
+{
+  return slide->priv->pending_json == NULL;
+}
+
+/*
+ * The JSON a lazily loaded slide will be built from, and the size it
+ * was loaded at, or NULL once it has been built.
+ */
+JsonObject *
+glide_slide_get_pending_json (GlideSlide *slide, gfloat *width, gfloat *height)
+{
+  if (width)
+    *width = slide->priv->pending_width;
+  if (height)
+    *height = slide->priv->pending_height;
+  
+  return slide->priv->pending_json;
+}
+
+void
+glide_slide_materialize (GlideSlide *slide)
+{
+  JsonObject *obj = slide->priv->pending_json;
+  gfloat width, height;
+  
+  if (!obj)
+    return;
+  slide->priv->pending_json = NULL;
+  
+  GLIDE_NOTE (DOCUMENT, "Materializing slide %p", slide);
+  
+  slide->priv->materializing = TRUE;
+  glide_slide_construct_from_json (slide, obj, 
+				   glide_actor_get_stage_manager (GLIDE_ACTOR (slide)));
+  slide->priv->materializing = FALSE;
+  
+  // The document may have been resized since the slide was loaded.
+  clutter_actor_get_size (CLUTTER_ACTOR (slide), &width, &height);
+  if (width != slide->priv->pending_width || height != slide->priv->pending_height)
+    {
+      glide_slide_scale_contents (slide, width/slide->priv->pending_width,
+				  height/slide->priv->pending_height, width);
+      glide_slide_mark_dirty (slide);
+    }
+  
+  json_object_unref (obj);
+}
+
 static CoglHandle
 glide_slide_material_for_file (const gchar *filename)
 {
   GError *e = NULL;
   CoglHandle m, t;
   
+  // The texture is shared, but paint sets the color on the material
+  // so each slide needs its own.
   m = cogl_material_new ();
-  t = cogl_texture_new_from_file(filename,
-				 COGL_TEXTURE_NONE,
-				 COGL_PIXEL_FORMAT_ANY,
-				 &e);
-  if (e || t == COGL_INVALID_HANDLE)
+  t = glide_texture_cache_get_texture (filename, &e);
+  if (t == COGL_INVALID_HANDLE)
     {
-      g_warning ("glide-slide.c failed to load widget image: %s", filename);
+      g_warning ("glide-slide.c failed to load background image: %s", filename);
       g_error_free (e);
+      
+      return m;
     }
   cogl_material_set_layer (m, 0, t);
-  cogl_material_set_layer_filters (m, 0,
-				   COGL_MATERIAL_FILTER_LINEAR_MIPMAP_LINEAR,
-				   COGL_MATERIAL_FILTER_LINEAR);
   cogl_handle_unref (t);
   
   return m;
@@ -642,6 +884,8 @@ glide_slide_set_background (GlideSlide *slide, const gchar *background)
   if (!background)
     return;
   
+  glide_slide_materialize (slide);
+  
   if (slide->priv->background)
     g_free (slide->priv->background);
   
@@ -650,6 +894,7 @@ glide_slide_set_background (GlideSlide *slide, const gchar *background)
   if (slide->priv->background_material)
     cogl_handle_unref (slide->priv->background_material);
   slide->priv->background_material = glide_slide_material_for_file (background);
+  glide_slide_mark_dirty (slide);
   
   g_object_notify (G_OBJECT (slide), "background");
   
@@ -659,25 +904,40 @@ glide_slide_set_background (GlideSlide *slide, const gchar *background)
 const gchar *
 glide_slide_get_background (GlideSlide *slide)
 {
+  if (!slide->priv->background && slide->priv->pending_json)
+    return glide_json_object_get_string (slide->priv->pending_json, "background");
   return slide->priv->background;
 }
 
 void 
 glide_slide_set_animation (GlideSlide *slide, const gchar *animation)
 {
+  glide_slide_materialize (slide);
+  
   if (slide->priv->animation)
     g_free (slide->priv->animation);
   
   slide->priv->animation = g_strdup (animation);
+  slide->priv->animation_info = glide_animations_lookup (animation);
+  glide_slide_mark_dirty (slide);
   g_object_notify (G_OBJECT (slide), "animation");
 }
 
 const gchar *
 glide_slide_get_animation (GlideSlide *slide)
 {
+  if (!slide->priv->animation && slide->priv->pending_json)
+    return glide_json_object_get_string (slide->priv->pending_json, "animation");
   return slide->priv->animation;
 }
 
+/* Resolved when the animation is set, NULL for none */
+GlideAnimationInfo *
+glide_slide_get_animation_info (GlideSlide *slide)
+{
+  return slide->priv->animation_info;
+}
+
 ClutterActor *
 glide_slide_get_contents (GlideSlide *slide)
 {
@@ -688,6 +948,7 @@ void
 glide_slide_set_color (GlideSlide *slide, const ClutterColor *color)
 {
   slide->priv->color = *color;
+  glide_slide_mark_dirty (slide);
   g_object_notify (G_OBJECT (slide), "color");
 
   clutter_actor_queue_redraw (CLUTTER_ACTOR (slide));
@@ -699,19 +960,10 @@ glide_slide_get_color (GlideSlide *slide, ClutterColor *color)
   *color = slide->priv->color;
 }
 
-void
-glide_slide_resize (GlideSlide *slide, gfloat width, gfloat height)
+static void
+glide_slide_scale_contents (GlideSlide *slide, gfloat rx, gfloat ry, gfloat width)
 {
   GList *a;
-  gfloat old_width, old_height, rx, ry;
-  
-  clutter_actor_get_size (CLUTTER_ACTOR (slide), &old_width, &old_height);
-  
-  rx = width/old_width;
-  ry = height/old_height;
-
-  clutter_actor_set_size (CLUTTER_ACTOR (slide->priv->contents_group), width, height);
-  clutter_actor_set_size (CLUTTER_ACTOR (slide), width, height);
   
   for (a = clutter_container_get_children (CLUTTER_CONTAINER (slide->priv->contents_group));
        a; a = a->next)
@@ -719,6 +971,9 @@ glide_slide_resize (GlideSlide *slide, gfloat width, gfloat height)
       ClutterActor *actor = (ClutterActor *)a->data;
       gfloat aw, ah, x, y, oh;
       
+      if (!GLIDE_IS_ACTOR (actor))
+	continue;
+      
       clutter_actor_get_position (actor, &x, &y);
       clutter_actor_get_size (actor, &aw, &ah);
       
@@ -742,3 +997,159 @@ glide_slide_resize (GlideSlide *slide, gfloat width, gfloat height)
 	}
     }
 }
+
+/* Texture memory held by the images on the slide, in bytes */
+gsize
+glide_slide_get_texture_memory (GlideSlide *slide)
+{
+  GList *children, *a;
+  gsize total = 0;
+  
+  children = clutter_container_get_children (CLUTTER_CONTAINER (slide->priv->contents_group));
+  for (a = children; a; a = a->next)
+    if (GLIDE_IS_IMAGE (a->data))
+      total += glide_image_get_texture_memory (GLIDE_IMAGE (a->data));
+  g_list_free (children);
+  
+  return total;
+}
+
+/*
+ * Does the work of the first paint ahead of time: builds the actors,
+ * lays them out, creates the text layouts with their glyphs and starts
+ * loading the image textures.
+ */
+void
+glide_slide_prefetch (GlideSlide *slide)
+{
+  GList *children, *a;
+  ClutterActorBox box;
+  
+  glide_slide_materialize (slide);
+  
+  clutter_actor_get_allocation_box (CLUTTER_ACTOR (slide), &box);
+  
+  children = clutter_container_get_children (CLUTTER_CONTAINER (slide->priv->contents_group));
+  for (a = children; a; a = a->next)
+    {
+      if (GLIDE_IS_TEXT (a->data))
+	glide_text_prepare_layout (GLIDE_TEXT (a->data));
+      else if (GLIDE_IS_IMAGE (a->data))
+	glide_image_prepare (GLIDE_IMAGE (a->data));
+    }
+  g_list_free (children);
+}
+
+void
+glide_slide_resize (GlideSlide *slide, gfloat width, gfloat height)
+{
+  gfloat old_width, old_height, rx, ry;
+  
+  clutter_actor_get_size (CLUTTER_ACTOR (slide), &old_width, &old_height);
+  
+  rx = width/old_width;
+  ry = height/old_height;
+
+  clutter_actor_set_size (CLUTTER_ACTOR (slide->priv->contents_group), width, height);
+  clutter_actor_set_size (CLUTTER_ACTOR (slide), width, height);
+  glide_slide_mark_dirty (slide);
+  
+  // Scaled from the loaded size once it is built.
+  if (slide->priv->pending_json)
+    return;
+  
+  glide_slide_scale_contents (slide, rx, ry, width);
+}
+
+/* Adds the modification time and size of filename, as the texture cache keys do */
+static void
+glide_slide_checksum_file (GChecksum *checksum, const gchar *filename)
+{
+  struct stat st;
+  gchar *stamp;
+  
+  if (!filename)
+    return;
+  if (g_stat (filename, &st) < 0)
+    st.st_mtime = st.st_size = 0;
+  
+  stamp = g_strdup_printf ("%s:%ld:%ld", filename, (long) st.st_mtime, (long) st.st_size);
+  g_checksum_update (checksum, (guchar *) stamp, -1);
+  g_free (stamp);
+}
+
+/*
+ * A checksum of everything the slide draws, for caching renderings of
+ * it. Image files are stamped with their modification time and size,
+ * so an image rewritten in place is noticed.
+ */
+gchar *
+glide_slide_get_checksum (GlideSlide *slide)
+{
+  JsonGenerator *gen = json_generator_new ();
+  JsonNode *node = glide_actor_serialize (GLIDE_ACTOR (slide));
+  GChecksum *checksum = g_checksum_new (G_CHECKSUM_SHA1);
+  JsonObject *obj;
+  gchar *data, *ret;
+  gsize length;
+  
+  json_generator_set_root (gen, node);
+  data = json_generator_to_data (gen, &length);
+  
+  g_checksum_update (checksum, (guchar *) data, length);
+  g_checksum_update (checksum, (guchar *) &slide->priv->color, sizeof (ClutterColor));
+  
+  obj = json_node_get_object (node);
+  glide_slide_checksum_file (checksum, glide_json_object_get_string (obj, "background"));
+  if (json_object_has_member (obj, "actors"))
+    {
+      JsonArray *actors = json_object_get_array_member (obj, "actors");
+      guint i;
+      
+      for (i = 0; i < json_array_get_length (actors); i++)
+	{
+	  JsonObject *actor_obj = json_array_get_object_element (actors, i);
+	  
+	  if (json_object_has_member (actor_obj, "image-properties"))
+	    glide_slide_checksum_file (checksum,
+				       glide_json_object_get_string (json_object_get_object_member (actor_obj, "image-properties"),
+								     "filename"));
+	}
+    }
+  ret = g_strdup (g_checksum_get_string (checksum));
+  
+  g_checksum_free (checksum);
+  g_free (data);
+  json_node_free (node);
+  g_object_unref (gen);
+  
+  return ret;
+}
+
+/*
+ * Called whenever something which is saved changes. Edits to the
+ * actors are noticed by the undo manager, and additions and removals
+ * by the slide itself.
+ */
+void
+glide_slide_mark_dirty (GlideSlide *slide)
+{
+  if (slide->priv->materializing)
+    return;
+  
+  if (slide->priv->serialized)
+    {
+      json_node_free (slide->priv->serialized);
+      slide->priv->serialized = NULL;
+    }
+  
+  if (slide->priv->document)
+    glide_document_slide_changed (slide->priv->document, slide);
+}
+
+/* Whether the next glide_slide_serialize has to do any work */
+gboolean
+glide_slide_get_dirty (GlideSlide *slide)
+{
+  return slide->priv->serialized == NULL;
+}
@@ -27,6 +27,7 @@
 #include <clutter/clutter.h>
 
 #include "glide-actor.h"
+#include "glide-animations.h"
 
 G_BEGIN_DECLS
 
@@ -57,12 +58,19 @@ GType glide_slide_get_type (void) G_GNUC_CONST;
 GlideSlide *glide_slide_new  (GlideDocument *document);
 
 void glide_slide_construct_from_json (GlideSlide *slide, JsonObject *slide_obj, GlideStageManager *manager);
+void glide_slide_construct_from_json_deferred (GlideSlide *slide, JsonObject *slide_obj);
+void glide_slide_replace_from_json (GlideSlide *slide, JsonObject *slide_obj);
+
+void glide_slide_materialize (GlideSlide *slide);
+gboolean glide_slide_get_materialized (GlideSlide *slide);
+JsonObject *glide_slide_get_pending_json (GlideSlide *slide, gfloat *width, gfloat *height);
 
 void glide_slide_set_background (GlideSlide *slide, const gchar *background);
 const gchar *glide_slide_get_background (GlideSlide *slide);
 
 void glide_slide_set_animation (GlideSlide *slide, const gchar *animation);
 const gchar *glide_slide_get_animation (GlideSlide *slide);
+GlideAnimationInfo *glide_slide_get_animation_info (GlideSlide *slide);
 
 void glide_slide_add_actor_content (GlideSlide *s, ClutterActor *a);
 
@@ -73,6 +81,15 @@ void glide_slide_get_color (GlideSlide *slide, ClutterColor *color);
 
 void glide_slide_resize (GlideSlide *slide, gfloat width, gfloat height);
 
+gsize glide_slide_get_texture_memory (GlideSlide *slide);
+
+void glide_slide_prefetch (GlideSlide *slide);
+
+gchar *glide_slide_get_checksum (GlideSlide *slide);
+
+void glide_slide_mark_dirty (GlideSlide *slide);
+gboolean glide_slide_get_dirty (GlideSlide *slide);
+
 
 G_END_DECLS
 
@@ -42,8 +42,25 @@ struct _GlideStageManagerPrivate
 
   gulong button_notify_id;
   gulong key_notify_id;
+  gulong paint_notify_id;
+  
+  guint frame_count;
   
   GlideUndoManager *undo_manager;
+  
+  gboolean lazy_load;
+  gboolean loading;
+  
+  /* Slides on either side of the current one to prepare while presenting */
+  guint prefetch_slides;
+  guint prefetch_id;
+  guint prefetch_step;
+  
+  /* At most one transition runs, further advances wait behind it */
+  ClutterTimeline *transition;
+  guint pending_advances;
+  guint advance_id;
+  gboolean skip_queued_transitions;
 };
 
 G_END_DECLS
@@ -31,6 +31,8 @@
 #include "glide-slide.h"
 
 #include "glide-animations.h"
+#include "glide-transition-stats.h"
+#include "glide-json-util.h"
 
 #include "glide-debug.h"
 
@@ -45,7 +47,11 @@ enum {
   PROP_DOCUMENT,
   PROP_CURRENT_SLIDE,
   PROP_PRESENTING,
-  PROP_UNDO_MANAGER
+  PROP_UNDO_MANAGER,
+  PROP_LAZY_LOAD,
+  PROP_FRAME_COUNT,
+  PROP_PREFETCH_SLIDES,
+  PROP_SKIP_QUEUED_TRANSITIONS
 };
 
 enum {
@@ -66,8 +72,19 @@ glide_stage_manager_finalize (GObject *object)
     g_signal_handler_disconnect (manager->priv->stage, manager->priv->button_notify_id);
   if (manager->priv->key_notify_id)
     g_signal_handler_disconnect (manager->priv->stage, manager->priv->key_notify_id);
+  if (manager->priv->paint_notify_id)
+    g_signal_handler_disconnect (manager->priv->stage, manager->priv->paint_notify_id);
+  if (manager->priv->prefetch_id)
+    g_source_remove (manager->priv->prefetch_id);
+  if (manager->priv->advance_id)
+    g_source_remove (manager->priv->advance_id);
+  if (manager->priv->transition)
+    g_object_unref (manager->priv->transition);
   
   g_object_unref (G_OBJECT (manager->priv->document));
+  
+  if (manager->priv->manip)
+    g_object_unref (manager->priv->manip);
 
   G_OBJECT_CLASS (glide_stage_manager_parent_class)->finalize (object);
 }
@@ -101,6 +118,18 @@ glide_stage_manager_get_property (GObject *object,
     case PROP_PRESENTING:
       g_value_set_boolean (value, manager->priv->presenting);
       break;
+    case PROP_LAZY_LOAD:
+      g_value_set_boolean (value, manager->priv->lazy_load);
+      break;
+    case PROP_FRAME_COUNT:
+      g_value_set_uint (value, manager->priv->frame_count);
+      break;
+    case PROP_PREFETCH_SLIDES:
+      g_value_set_uint (value, manager->priv->prefetch_slides);
+      break;
+    case PROP_SKIP_QUEUED_TRANSITIONS:
+      g_value_set_boolean (value, manager->priv->skip_queued_transitions);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -141,27 +170,105 @@ glide_stage_manager_set_selection_real (GlideStageManager *m,
 static void
 glide_stage_manager_add_manipulator (GlideStageManager *manager)
 {
-  GlideManipulator *manip;
-  ClutterActor *parent;
+  ClutterActor *manip, *parent, *contents;
+  GlideSlide *slide;
   
   if (!manager->priv->manip)
-    manip = glide_manipulator_new (NULL);
-  else
-    manip = manager->priv->manip;
+    {
+      manager->priv->manip = glide_manipulator_new (NULL);
+      g_object_ref_sink (manager->priv->manip);
+    }
+  manip = CLUTTER_ACTOR (manager->priv->manip);
+  
+  slide = glide_document_get_nth_slide (manager->priv->document,
+					manager->priv->current_slide);
+  contents = glide_slide_get_contents (slide);
   
-  if ((parent = clutter_actor_get_parent (CLUTTER_ACTOR (manip))))
+  parent = clutter_actor_get_parent (manip);
+  if (parent != contents)
     {
-      clutter_container_remove_actor (CLUTTER_CONTAINER (parent), CLUTTER_ACTOR (manip));
-      manip = glide_manipulator_new (NULL);
+      // The old selection stays behind on the old slide.
+      glide_stage_manager_set_selection (manager, NULL);
+      
+      if (parent)
+	clutter_actor_reparent (manip, contents);
+      else
+	glide_slide_add_actor_content (slide, manip);
     }
   
-  glide_slide_add_actor_content (glide_document_get_nth_slide (manager->priv->document,
-										manager->priv->current_slide), 
-						  CLUTTER_ACTOR (manip));
+  clutter_actor_hide_all (manip);
+}
+
+/* 
+ * Prepares one slide per idle, alternating next and previous and
+ * moving outwards: current+1, current-1, current+2...
+ */
+static gboolean
+glide_stage_manager_prefetch_idle (gpointer user_data)
+{
+  GlideStageManager *manager = (GlideStageManager *)user_data;
+  GlideStageManagerPrivate *priv = manager->priv;
+  guint n_slides = glide_document_get_n_slides (priv->document);
   
-  clutter_actor_hide_all (CLUTTER_ACTOR (manip));
+  while (priv->prefetch_step < 2 * priv->prefetch_slides)
+    {
+      gint distance = priv->prefetch_step / 2 + 1;
+      gint slide = priv->current_slide + (priv->prefetch_step % 2 ? -distance : distance);
+      
+      priv->prefetch_step++;
+      
+      if (slide >= 0 && slide < (gint) n_slides)
+	{
+	  GTimer *timer = g_timer_new ();
+	  
+	  glide_slide_prefetch (glide_document_get_nth_slide (priv->document, slide));
+	  
+	  GLIDE_NOTE (STAGE_MANAGER, "Prefetched slide %d in %f seconds", slide,
+		      g_timer_elapsed (timer, NULL));
+	  g_timer_destroy (timer);
+	  
+	  return TRUE;
+	}
+    }
   
-  manager->priv->manip = manip;
+  priv->prefetch_id = 0;
+  return FALSE;
+}
+
+static void
+glide_stage_manager_queue_prefetch (GlideStageManager *manager)
+{
+  GlideStageManagerPrivate *priv = manager->priv;
+  
+  priv->prefetch_step = 0;
+  
+  if (!priv->presenting || !priv->prefetch_slides)
+    {
+      if (priv->prefetch_id)
+	g_source_remove (priv->prefetch_id);
+      priv->prefetch_id = 0;
+      
+      return;
+    }
+  
+  // Below redraws, so a running transition keeps its frames.
+  if (!priv->prefetch_id)
+    priv->prefetch_id = g_idle_add_full (G_PRIORITY_LOW, glide_stage_manager_prefetch_idle,
+					 manager, NULL);
+}
+
+static void
+glide_stage_manager_materialize_slides (GlideStageManager *manager, guint slide)
+{
+  GlideDocument *document = manager->priv->document;
+  
+  glide_slide_materialize (glide_document_get_nth_slide (document, slide));
+  
+  // Neighbours, so the next transition doesn't wait on them.
+  if (slide + 1 < glide_document_get_n_slides (document))
+    glide_slide_materialize (glide_document_get_nth_slide (document, slide + 1));
+  if (slide > 0)
+    glide_slide_materialize (glide_document_get_nth_slide (document, slide - 1));
 }
 
 void
@@ -170,10 +277,16 @@ glide_stage_manager_set_slide (GlideStageManager *manager, guint slide)
   if (manager->priv->current_slide >= 0 && !(manager->priv->current_slide >= glide_document_get_n_slides(manager->priv->document)))
     clutter_actor_hide (CLUTTER_ACTOR (glide_document_get_nth_slide (manager->priv->document, manager->priv->current_slide)));
   manager->priv->current_slide = slide;
+  glide_stage_manager_materialize_slides (manager, slide);
   clutter_actor_show_all (CLUTTER_ACTOR (glide_document_get_nth_slide (manager->priv->document, slide)));  
   
   glide_stage_manager_add_manipulator (manager);
   
+  glide_stage_manager_queue_prefetch (manager);
+  
+  GLIDE_NOTE (STAGE_MANAGER, "Slide %u holds %lu bytes of image textures", slide,
+	      (gulong) glide_slide_get_texture_memory (glide_document_get_nth_slide (manager->priv->document, slide)));
+  
   g_object_notify (G_OBJECT (manager), "current-slide");
 }
 
@@ -206,6 +319,13 @@ glide_stage_manager_document_slide_added_cb (GlideDocument *document,
   clutter_actor_get_size (manager->priv->stage, &width, &height);
   clutter_actor_set_size (CLUTTER_ACTOR (slide), width, height);
   
+  // glide_stage_manager_load_slides picks the current slide when done
+  if (manager->priv->loading)
+    {
+      clutter_actor_hide (CLUTTER_ACTOR (slide));
+      return;
+    }
+  
   glide_stage_manager_set_slide (manager, manager->priv->current_slide+1);
   glide_stage_manager_set_selection (manager, NULL);
 }
@@ -219,21 +339,61 @@ glide_stage_manager_set_document (GlideStageManager *manager,
   g_signal_connect (document, "slide-removed", G_CALLBACK (glide_stage_manager_document_slide_removed_cb), manager);
 }
 
-void
-glide_stage_manager_advance_slide (GlideStageManager *manager)
+static gboolean glide_stage_manager_advance_idle (gpointer user_data);
+
+static void
+glide_stage_manager_transition_completed (ClutterTimeline *timeline,
+					  gpointer user_data)
+{
+  GlideStageManager *manager = (GlideStageManager *)user_data;
+  
+  g_signal_handlers_disconnect_by_func (timeline, glide_stage_manager_transition_completed, manager);
+  
+  if (manager->priv->transition == timeline)
+    {
+      g_object_unref (manager->priv->transition);
+      manager->priv->transition = NULL;
+    }
+  
+  // Advances which arrived meanwhile are handled together.
+  if (manager->priv->pending_advances && !manager->priv->advance_id)
+    manager->priv->advance_id = g_idle_add (glide_stage_manager_advance_idle, manager);
+}
+
+/* Jumps the running transition, if any, to its end */
+static void
+glide_stage_manager_finish_transition (GlideStageManager *manager)
+{
+  if (manager->priv->transition)
+    glide_animations_timeline_finish (manager->priv->transition);
+}
+
+static void
+glide_stage_manager_cancel_advances (GlideStageManager *manager)
+{
+  manager->priv->pending_advances = 0;
+  if (manager->priv->advance_id)
+    g_source_remove (manager->priv->advance_id);
+  manager->priv->advance_id = 0;
+  
+  glide_stage_manager_finish_transition (manager);
+}
+
+static void
+glide_stage_manager_advance_slide_real (GlideStageManager *manager)
 {
   if (manager->priv->current_slide + 1 < glide_document_get_n_slides(manager->priv->document))
     {
       GlideSlide *a, *b;
-      const gchar *animation;
+      GlideAnimationInfo *animation;
 
       
       a = glide_document_get_nth_slide (manager->priv->document, manager->priv->current_slide);
       b = glide_document_get_nth_slide (manager->priv->document, manager->priv->current_slide+1);
 
-      animation = glide_slide_get_animation (a);
+      animation = glide_slide_get_animation_info (a);
       
-      if (!animation || !strcmp(animation, "None"))
+      if (!animation)
 	{
 	  glide_stage_manager_set_slide_next (manager);
 	  return;
@@ -241,20 +401,12 @@ glide_stage_manager_advance_slide (GlideStageManager *manager)
 
       manager->priv->current_slide++;
       
-      if (!strcmp(animation, "Drop"))
-	glide_animations_animate_drop (CLUTTER_ACTOR (a), CLUTTER_ACTOR (b), 1500);
-      if (!strcmp(animation, "Fade"))
-	glide_animations_animate_fade (CLUTTER_ACTOR (a), CLUTTER_ACTOR (b), 1000);
-      if (!strcmp(animation, "Zoom"))
-	glide_animations_animate_zoom (CLUTTER_ACTOR (a), CLUTTER_ACTOR (b), 1200);
-      if (!strcmp(animation, "Pivot"))
-	glide_animations_animate_pivot (CLUTTER_ACTOR (a), CLUTTER_ACTOR (b), 2000);
-      if (!strcmp(animation, "Slide"))
-	glide_animations_animate_slide (CLUTTER_ACTOR (a), CLUTTER_ACTOR (b), 1200);
-      if (!strcmp(animation, "Zoom Contents"))
-	glide_animations_animate_zoom_contents (CLUTTER_ACTOR (a), CLUTTER_ACTOR (b), 1200);
-      if (!strcmp(animation, "Doorway"))
-	glide_animations_animate_doorway (CLUTTER_ACTOR (a), CLUTTER_ACTOR (b), 1200);
+      manager->priv->transition = g_object_ref (glide_animations_run (animation, CLUTTER_ACTOR (a), CLUTTER_ACTOR (b)));
+      g_signal_connect (manager->priv->transition, "completed",
+			G_CALLBACK (glide_stage_manager_transition_completed), manager);
+      
+      glide_transition_stats_watch (manager->priv->transition, manager->priv->current_slide - 1);
+      glide_stage_manager_queue_prefetch (manager);
       
       // XXX: Maybe not?
       g_object_notify (G_OBJECT (manager), "current-slide");
@@ -264,9 +416,59 @@ glide_stage_manager_advance_slide (GlideStageManager *manager)
     glide_stage_manager_set_presenting (manager, FALSE);
 }
 
+static gboolean
+glide_stage_manager_advance_idle (gpointer user_data)
+{
+  GlideStageManager *manager = (GlideStageManager *)user_data;
+  GlideStageManagerPrivate *priv = manager->priv;
+  gint last = glide_document_get_n_slides (priv->document) - 1;
+  
+  priv->advance_id = 0;
+  
+  GLIDE_NOTE (STAGE_MANAGER, "Handling %u queued advances", priv->pending_advances);
+  
+  if (priv->skip_queued_transitions && priv->pending_advances > 1)
+    {
+      glide_stage_manager_set_slide (manager, MIN (priv->current_slide + (gint)priv->pending_advances, last));
+      priv->pending_advances = 0;
+    }
+  else if (priv->pending_advances)
+    {
+      priv->pending_advances--;
+      
+      // Running past the end would end the presentation.
+      if (priv->current_slide < last)
+	glide_stage_manager_advance_slide_real (manager);
+      else
+	priv->pending_advances = 0;
+    }
+  
+  return FALSE;
+}
+
+/*
+ * Advancing while a transition runs jumps it to its end and queues the
+ * advance, so no more than two slides are ever animated at once.
+ */
+void
+glide_stage_manager_advance_slide (GlideStageManager *manager)
+{
+  if (manager->priv->transition || manager->priv->advance_id)
+    {
+      manager->priv->pending_advances++;
+      glide_stage_manager_finish_transition (manager);
+      
+      return;
+    }
+  
+  glide_stage_manager_advance_slide_real (manager);
+}
+
 void
 glide_stage_manager_reverse_slide (GlideStageManager *manager)
 {
+  glide_stage_manager_cancel_advances (manager);
+
   glide_stage_manager_set_slide_prev (manager);
 }
 
@@ -309,6 +511,16 @@ glide_stage_manager_key_pressed (ClutterActor *actor,
 					G_OBJECT (m));  
 }
 
+static void
+glide_stage_manager_stage_paint (ClutterActor *stage,
+				 gpointer user_data)
+{
+  GlideStageManager *m = (GlideStageManager *)user_data;
+  
+  m->priv->frame_count++;
+  GLIDE_NOTE (PAINT, "Stage frame %u", m->priv->frame_count);
+}
+
 static void
 glide_stage_manager_set_property (GObject *object,
 				  guint prop_id,
@@ -325,6 +537,7 @@ glide_stage_manager_set_property (GObject *object,
       
       manager->priv->button_notify_id = g_signal_connect (G_OBJECT (manager->priv->stage), "button-press-event", G_CALLBACK(glide_stage_manager_button_pressed), manager);
       manager->priv->key_notify_id = g_signal_connect (G_OBJECT (manager->priv->stage), "key-press-event", G_CALLBACK(glide_stage_manager_key_pressed), manager);
+      manager->priv->paint_notify_id = g_signal_connect (G_OBJECT (manager->priv->stage), "paint", G_CALLBACK(glide_stage_manager_stage_paint), manager);
       break;
     case PROP_DOCUMENT:
       g_return_if_fail (manager->priv->document == NULL);
@@ -346,6 +559,15 @@ glide_stage_manager_set_property (GObject *object,
       glide_stage_manager_set_undo_manager (manager,
 					    GLIDE_UNDO_MANAGER (g_value_get_object (value)));
       break;
+    case PROP_LAZY_LOAD:
+      glide_stage_manager_set_lazy_load (manager, g_value_get_boolean (value));
+      break;
+    case PROP_PREFETCH_SLIDES:
+      glide_stage_manager_set_prefetch_slides (manager, g_value_get_uint (value));
+      break;
+    case PROP_SKIP_QUEUED_TRANSITIONS:
+      glide_stage_manager_set_skip_queued_transitions (manager, g_value_get_boolean (value));
+      break;
     default: 
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -433,7 +655,7 @@ glide_stage_manager_binding_move_up (GlideStageManager         *self,
 					 GLIDE_ACTOR (selection),
 					 "Move actor");
   clutter_actor_set_y (selection, clutter_actor_get_y (selection) - 1);
-  glide_undo_manager_end_actor_action (glide_actor_get_undo_manager (GLIDE_ACTOR (selection)),
+  glide_undo_manager_end_coalesced_actor_action (glide_actor_get_undo_manager (GLIDE_ACTOR (selection)),
 				       GLIDE_ACTOR (selection));
   
   return TRUE;
@@ -457,7 +679,7 @@ glide_stage_manager_binding_move_down (GlideStageManager         *self,
 					 GLIDE_ACTOR (selection),
 					 "Move actor");  
   clutter_actor_set_y (selection, clutter_actor_get_y (selection) + 1);
-glide_undo_manager_end_actor_action (glide_actor_get_undo_manager (GLIDE_ACTOR (selection)),
+glide_undo_manager_end_coalesced_actor_action (glide_actor_get_undo_manager (GLIDE_ACTOR (selection)),
 				       GLIDE_ACTOR (selection));
   
   return TRUE;
@@ -484,7 +706,7 @@ glide_stage_manager_binding_move_left (GlideStageManager         *self,
 					 GLIDE_ACTOR (selection),
 					 "Move actor");  
   clutter_actor_set_x (selection, clutter_actor_get_x (selection) - 1);
-  glide_undo_manager_end_actor_action (glide_actor_get_undo_manager (GLIDE_ACTOR (selection)),
+  glide_undo_manager_end_coalesced_actor_action (glide_actor_get_undo_manager (GLIDE_ACTOR (selection)),
 				     GLIDE_ACTOR (selection));
   
   return TRUE;
@@ -511,7 +733,7 @@ glide_stage_manager_binding_move_right (GlideStageManager         *self,
 					 GLIDE_ACTOR (selection),
 					 "Move actor");  
   clutter_actor_set_x (selection, clutter_actor_get_x (selection) + 1);
-  glide_undo_manager_end_actor_action (glide_actor_get_undo_manager (GLIDE_ACTOR (selection)),
+  glide_undo_manager_end_coalesced_actor_action (glide_actor_get_undo_manager (GLIDE_ACTOR (selection)),
 				     GLIDE_ACTOR (selection));
   
   return TRUE;
@@ -536,7 +758,7 @@ glide_stage_manager_binding_move_up_snap (GlideStageManager         *self,
 					 "Move actor");  
   clutter_actor_set_y (selection, (clutter_actor_get_y(selection) - 10)-(gint)(clutter_actor_get_y(selection) - 10)%10);
 
-  glide_undo_manager_end_actor_action (glide_actor_get_undo_manager (GLIDE_ACTOR (selection)),
+  glide_undo_manager_end_coalesced_actor_action (glide_actor_get_undo_manager (GLIDE_ACTOR (selection)),
 				       GLIDE_ACTOR (selection));
   
   return TRUE;
@@ -560,7 +782,7 @@ glide_stage_manager_binding_move_down_snap (GlideStageManager         *self,
 					 GLIDE_ACTOR (selection),
 					 "Move actor");
   clutter_actor_set_y (selection, (clutter_actor_get_y(selection) + 10)-(gint)(clutter_actor_get_y(selection) + 10)%10);  
-  glide_undo_manager_end_actor_action (glide_actor_get_undo_manager (GLIDE_ACTOR (selection)),
+  glide_undo_manager_end_coalesced_actor_action (glide_actor_get_undo_manager (GLIDE_ACTOR (selection)),
 				       GLIDE_ACTOR (selection));
   
   return TRUE;
@@ -586,7 +808,7 @@ glide_stage_manager_binding_move_left_snap (GlideStageManager         *self,
 					 GLIDE_ACTOR (selection),
 					 "Move actor");  
   clutter_actor_set_x (selection, (clutter_actor_get_x(selection) - 10)-(gint)(clutter_actor_get_x(selection) - 10)%10);  
-  glide_undo_manager_end_actor_action (glide_actor_get_undo_manager (GLIDE_ACTOR (selection)),
+  glide_undo_manager_end_coalesced_actor_action (glide_actor_get_undo_manager (GLIDE_ACTOR (selection)),
 				       GLIDE_ACTOR (selection));
 
   
@@ -612,7 +834,7 @@ glide_stage_manager_binding_move_right_snap (GlideStageManager         *self,
 					 GLIDE_ACTOR (selection),
 					 "Move actor");
   clutter_actor_set_x (selection, (clutter_actor_get_x(selection) + 10)-(gint)(clutter_actor_get_x(selection) + 10)%10);  
-  glide_undo_manager_end_actor_action (glide_actor_get_undo_manager (GLIDE_ACTOR (selection)),
+  glide_undo_manager_end_coalesced_actor_action (glide_actor_get_undo_manager (GLIDE_ACTOR (selection)),
 				       GLIDE_ACTOR (selection));
   
   return TRUE;
@@ -684,6 +906,38 @@ glide_stage_manager_class_init (GlideStageManagerClass *klass)
 							G_PARAM_READWRITE |
 							G_PARAM_CONSTRUCT_ONLY |
 							G_PARAM_STATIC_STRINGS));
+  
+  g_object_class_install_property (object_class,
+				   PROP_LAZY_LOAD,
+				   g_param_spec_boolean ("lazy-load",
+							 "Lazy load",
+							 "Whether loaded slides are only built when they are first needed",
+							 TRUE,
+							 G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  
+  g_object_class_install_property (object_class,
+				   PROP_FRAME_COUNT,
+				   g_param_spec_uint ("frame-count",
+						      "Frame count",
+						      "The number of frames the stage has painted",
+						      0, G_MAXUINT, 0,
+						      G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+  
+  g_object_class_install_property (object_class,
+				   PROP_PREFETCH_SLIDES,
+				   g_param_spec_uint ("prefetch-slides",
+						      "Prefetch slides",
+						      "The number of slides on either side of the current one prepared while presenting",
+						      0, G_MAXUINT, 1,
+						      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  
+  g_object_class_install_property (object_class,
+				   PROP_SKIP_QUEUED_TRANSITIONS,
+				   g_param_spec_boolean ("skip-queued-transitions",
+							 "Skip queued transitions",
+							 "Whether several advances queued behind a transition jump straight to their slide",
+							 FALSE,
+							 G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
   
   // Argument is old selection
@@ -747,6 +1001,8 @@ static void
 glide_stage_manager_init (GlideStageManager *manager)
 {
   manager->priv = GLIDE_STAGE_MANAGER_GET_PRIVATE (manager);
+  manager->priv->lazy_load = TRUE;
+  manager->priv->prefetch_slides = 1;
 }
 
 GlideStageManager *
@@ -827,23 +1083,135 @@ glide_stage_manager_set_current_slide (GlideStageManager *manager, guint slide)
   glide_stage_manager_set_slide (manager, slide);
 }
 
+static void
+glide_stage_manager_load_slide (GlideStageManager *manager, GlideSlide *slide, JsonObject *slide_obj)
+{
+  if (manager->priv->lazy_load)
+    glide_slide_construct_from_json_deferred (slide, slide_obj);
+  else
+    glide_slide_construct_from_json (slide, slide_obj, manager);
+}
+
+static void
+glide_stage_manager_finish_loading (GlideStageManager *manager, guint first, GTimer *timer)
+{
+  guint n_slides = glide_document_get_n_slides (manager->priv->document);
+  
+  manager->priv->loading = FALSE;
+  
+  if (first < n_slides)
+    glide_stage_manager_set_slide (manager, first);
+  glide_stage_manager_set_selection (manager, NULL);
+  
+  GLIDE_NOTE (STAGE_MANAGER, "Loaded %u slides (lazy: %d) in %f seconds",
+	      n_slides - first, manager->priv->lazy_load, g_timer_elapsed (timer, NULL));
+  g_timer_destroy (timer);
+}
+
 // TODO: Error handling.
 void
 glide_stage_manager_load_slides (GlideStageManager *manager, JsonArray *slides)
 {
-  GList *slides_list, *s;
+  guint i, first, n_slides;
+  GTimer *timer = g_timer_new ();
   
   // Handle broken first slide.
   
-  slides_list = json_array_get_elements (slides);
-  for (s = slides_list; s; s = s->next)
+  n_slides = json_array_get_length (slides);
+  
+  manager->priv->loading = TRUE;
+  first = glide_document_append_slides (manager->priv->document, n_slides);
+  for (i = 0; i < n_slides; i++)
     {
-      JsonNode *n = s->data;
-      JsonObject *slide = json_node_get_object (n);
-      GlideSlide *gs = glide_document_append_slide (manager->priv->document);
+      JsonObject *slide = json_array_get_object_element (slides, i);
+      GlideSlide *gs = glide_document_get_nth_slide (manager->priv->document, first + i);
       
-      glide_slide_construct_from_json (gs, slide, manager);
+      glide_stage_manager_load_slide (manager, gs, slide);
     }
+  
+  glide_stage_manager_finish_loading (manager, first, timer);
+}
+
+static void
+glide_stage_manager_load_member (const gchar *member_name,
+				 JsonObject *member,
+				 gpointer user_data)
+{
+  GlideStageManager *manager = (GlideStageManager *)user_data;
+  
+  if (!strcmp (member_name, "name"))
+    glide_document_set_name (manager->priv->document,
+			     glide_json_object_get_string (member, "name"));
+  else if (!strcmp (member_name, "version") &&
+	   json_object_get_int_member (member, "version") > GLIDE_DOCUMENT_SCHEMA_VERSION)
+    g_warning ("Document was saved in a newer format (version %d), some of it may be lost",
+	       (gint) json_object_get_int_member (member, "version"));
+}
+
+/*
+ * Called as each element of "slides" is read. A lazily loaded slide keeps
+ * its own object until it is first shown, otherwise it is built here and
+ * the object goes with the next element.
+ */
+static void
+glide_stage_manager_load_element (JsonObject *slide_obj,
+				  gpointer user_data)
+{
+  GlideStageManager *manager = (GlideStageManager *)user_data;
+  GlideSlide *slide = glide_document_append_slide (manager->priv->document);
+  
+  glide_stage_manager_load_slide (manager, slide, slide_obj);
+}
+
+gboolean
+glide_stage_manager_load_file (GlideStageManager *manager, const gchar *filename, GError **error)
+{
+  GTimer *timer = g_timer_new ();
+  gboolean ret;
+  
+  manager->priv->loading = TRUE;
+  ret = glide_json_stream_object_file (filename, "slides",
+				       glide_stage_manager_load_member,
+				       glide_stage_manager_load_element,
+				       manager, error);
+  
+  glide_stage_manager_finish_loading (manager, 0, timer);
+  
+  return ret;
+}
+
+guint
+glide_stage_manager_get_frame_count (GlideStageManager *manager)
+{
+  return manager->priv->frame_count;
+}
+
+gboolean
+glide_stage_manager_get_lazy_load (GlideStageManager *manager)
+{
+  return manager->priv->lazy_load;
+}
+
+void
+glide_stage_manager_set_lazy_load (GlideStageManager *manager, gboolean lazy_load)
+{
+  manager->priv->lazy_load = lazy_load;
+  g_object_notify (G_OBJECT (manager), "lazy-load");
+}
+
+guint
+glide_stage_manager_get_prefetch_slides (GlideStageManager *manager)
+{
+  return manager->priv->prefetch_slides;
+}
+
+void
+glide_stage_manager_set_prefetch_slides (GlideStageManager *manager, guint prefetch_slides)
+{
+  manager->priv->prefetch_slides = prefetch_slides;
+  glide_stage_manager_queue_prefetch (manager);
+  
+  g_object_notify (G_OBJECT (manager), "prefetch-slides");
 }
 
 void
@@ -852,14 +1220,39 @@ glide_stage_manager_set_presenting (GlideStageManager *manager, gboolean present
   if (presenting != manager->priv->presenting)
     {
       manager->priv->presenting = presenting;
+      glide_stage_manager_cancel_advances (manager);
       if (presenting)
       	glide_stage_manager_set_selection (manager, NULL);
       else
-	glide_stage_manager_add_manipulator (manager);
+	{
+	  GError *e = NULL;
+	  
+	  glide_stage_manager_add_manipulator (manager);
+	  
+	  if (!glide_transition_stats_write (&e))
+	    {
+	      g_warning ("Failed to write transition statistics: %s", e->message);
+	      g_error_free (e);
+	    }
+	}
+      glide_stage_manager_queue_prefetch (manager);
       g_object_notify (G_OBJECT (manager), "presenting");
     }
 }
 
+gboolean
+glide_stage_manager_get_skip_queued_transitions (GlideStageManager *manager)
+{
+  return manager->priv->skip_queued_transitions;
+}
+
+void
+glide_stage_manager_set_skip_queued_transitions (GlideStageManager *manager, gboolean skip)
+{
+  manager->priv->skip_queued_transitions = skip;
+  g_object_notify (G_OBJECT (manager), "skip-queued-transitions");
+}
+
 gboolean
 glide_stage_manager_get_presenting (GlideStageManager *manager)
 {
@@ -96,6 +96,18 @@ gint glide_stage_manager_get_current_slide (GlideStageManager *manager);
 void glide_stage_manager_set_current_slide (GlideStageManager *manager, guint slide);
 
 void glide_stage_manager_load_slides (GlideStageManager *manager, JsonArray *slides);
+gboolean glide_stage_manager_load_file (GlideStageManager *manager, const gchar *filename, GError **error);
+
+guint glide_stage_manager_get_frame_count (GlideStageManager *manager);
+
+gboolean glide_stage_manager_get_lazy_load (GlideStageManager *manager);
+void glide_stage_manager_set_lazy_load (GlideStageManager *manager, gboolean lazy_load);
+
+guint glide_stage_manager_get_prefetch_slides (GlideStageManager *manager);
+void glide_stage_manager_set_prefetch_slides (GlideStageManager *manager, guint prefetch_slides);
+
+gboolean glide_stage_manager_get_skip_queued_transitions (GlideStageManager *manager);
+void glide_stage_manager_set_skip_queued_transitions (GlideStageManager *manager, gboolean skip);
 
 gboolean glide_stage_manager_get_presenting (GlideStageManager *manager);
 void glide_stage_manager_set_presenting (GlideStageManager *manager, gboolean presenting);
@@ -881,6 +881,24 @@ glide_text_update_actor_size (GlideText *self)
   clutter_actor_set_height (CLUTTER_ACTOR (self), logical_rect.height / 1024.0f );
 }
 
+/*
+ * Builds the layout paint will use for the current allocation and
+ * fills the glyph cache for it, ahead of the first paint.
+ */
+void
+glide_text_prepare_layout (GlideText *self)
+{
+  ClutterActorBox alloc = { 0, };
+  
+  if (self->priv->font_desc == NULL || self->priv->text == NULL)
+    return;
+  
+  clutter_actor_get_allocation_box (CLUTTER_ACTOR (self), &alloc);
+  glide_text_create_layout (self,
+			    alloc.x2 - alloc.x1,
+			    alloc.y2 - alloc.y1);
+}
+
 static inline void
 glide_text_set_text_internal (GlideText *self,
                                 const gchar *text)
@@ -228,6 +228,7 @@ void glide_text_set_font_size (GlideText *self, gdouble font_size);
 gdouble glide_text_get_font_size (GlideText *self);
 
 void glide_text_update_actor_size (GlideText *self);
+void glide_text_prepare_layout (GlideText *self);
 
 G_END_DECLS
 
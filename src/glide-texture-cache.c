@@ -0,0 +1,294 @@
+/*
+ * glide-texture-cache.c
+ * This file is part of glide
+ *
+ * Copyright (C) 2010 - Robert Carr
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#include <glib/gstdio.h>
+#include <clutter/clutter.h>
+
+#include "glide-texture-cache.h"
+
+#include "glide-debug.h"
+
+#define DEFAULT_TEXTURE_CACHE_BUDGET (256 * 1024 * 1024)
+
+/*
+ * Textures are keyed by canonical path and modification time, so an
+ * image which changes on disk is loaded again. The cache holds one
+ * reference on each entry, evicting the least recently used ones
+ * once the estimated size passes the budget. Evicted textures stay
+ * alive for as long as an actor holds a reference.
+ */
+typedef struct _GlideTextureCacheEntry {
+  gchar *key;
+
+  CoglHandle texture;
+  CoglHandle material;
+
+  gsize size;
+  GList *link;
+} GlideTextureCacheEntry;
+
+static GHashTable *cache_entries = NULL;
+static GQueue cache_lru = G_QUEUE_INIT;
+
+static gsize cache_size = 0;
+static gsize cache_budget = DEFAULT_TEXTURE_CACHE_BUDGET;
+
+static guint cache_hits = 0;
+static guint cache_misses = 0;
+
+static void
+glide_texture_cache_entry_free (gpointer data)
+{
+  GlideTextureCacheEntry *entry = (GlideTextureCacheEntry *)data;
+
+  cogl_handle_unref (entry->texture);
+  if (entry->material != COGL_INVALID_HANDLE)
+    cogl_handle_unref (entry->material);
+
+  g_free (entry->key);
+  g_slice_free (GlideTextureCacheEntry, entry);
+}
+
+static gchar *
+glide_texture_cache_make_key (const gchar *filename, guint scale)
+{
+  struct stat st;
+  char *path = realpath (filename, NULL);
+  gchar *key;
+
+  if (g_stat (path ? path : filename, &st) < 0)
+    st.st_mtime = 0;
+
+  if (scale > 1)
+    key = g_strdup_printf ("%s:%ld@%u", path ? path : filename, (long) st.st_mtime, scale);
+  else
+    key = g_strdup_printf ("%s:%ld", path ? path : filename, (long) st.st_mtime);
+  free (path);
+
+  return key;
+}
+
+static void
+glide_texture_cache_remove_entry (GlideTextureCacheEntry *entry)
+{
+  GLIDE_NOTE (IMAGE, "Evicting texture from cache: %s", entry->key);
+
+  g_queue_delete_link (&cache_lru, entry->link);
+  cache_size -= entry->size;
+
+  g_hash_table_remove (cache_entries, entry->key);
+}
+
+static void
+glide_texture_cache_evict (GlideTextureCacheEntry *keep)
+{
+  while (cache_size > cache_budget)
+    {
+      GlideTextureCacheEntry *oldest = g_queue_peek_tail (&cache_lru);
+
+      if (!oldest || oldest == keep)
+	break;
+      glide_texture_cache_remove_entry (oldest);
+    }
+}
+
+static GlideTextureCacheEntry *
+glide_texture_cache_find (const gchar *key)
+{
+  GlideTextureCacheEntry *entry;
+
+  if (!cache_entries)
+    cache_entries = g_hash_table_new_full (g_str_hash, g_str_equal,
+					   NULL, glide_texture_cache_entry_free);
+
+  if ((entry = g_hash_table_lookup (cache_entries, key)))
+    {
+      cache_hits++;
+
+      g_queue_unlink (&cache_lru, entry->link);
+      g_queue_push_head_link (&cache_lru, entry->link);
+    }
+
+  return entry;
+}
+
+/* Takes ownership of both key and texture */
+static GlideTextureCacheEntry *
+glide_texture_cache_add (gchar *key, CoglHandle texture)
+{
+  GlideTextureCacheEntry *entry;
+
+  entry = g_slice_new0 (GlideTextureCacheEntry);
+  entry->key = key;
+  entry->texture = texture;
+  entry->material = COGL_INVALID_HANDLE;
+  entry->size = cogl_texture_get_width (texture) * cogl_texture_get_height (texture) * 4;
+
+  g_queue_push_head (&cache_lru, entry);
+  entry->link = cache_lru.head;
+  g_hash_table_insert (cache_entries, entry->key, entry);
+
+  cache_size += entry->size;
+
+  GLIDE_NOTE (IMAGE, "Added texture to cache: %s (%lu bytes, %lu total)",
+	      key, (gulong) entry->size, (gulong) cache_size);
+
+  glide_texture_cache_evict (entry);
+
+  return entry;
+}
+
+static GlideTextureCacheEntry *
+glide_texture_cache_lookup (const gchar *filename, GError **error)
+{
+  GlideTextureCacheEntry *entry;
+  CoglHandle texture;
+  GError *e = NULL;
+  gchar *key;
+
+  key = glide_texture_cache_make_key (filename, 1);
+  if ((entry = glide_texture_cache_find (key)))
+    {
+      g_free (key);
+      return entry;
+    }
+
+  cache_misses++;
+
+  texture = cogl_texture_new_from_file (filename,
+					COGL_TEXTURE_NONE,
+					COGL_PIXEL_FORMAT_ANY,
+					&e);
+  if (e == NULL && texture == COGL_INVALID_HANDLE)
+    {
+      g_set_error (&e, CLUTTER_TEXTURE_ERROR,
+		   CLUTTER_TEXTURE_ERROR_BAD_FORMAT,
+		   "Failed to create COGL texture");
+    }
+  if (e != NULL)
+    {
+      if (texture != COGL_INVALID_HANDLE)
+	cogl_handle_unref (texture);
+      g_propagate_error (error, e);
+      g_free (key);
+
+      return NULL;
+    }
+
+  return glide_texture_cache_add (key, texture);
+}
+
+CoglHandle
+glide_texture_cache_get_texture (const gchar *filename, GError **error)
+{
+  GlideTextureCacheEntry *entry = glide_texture_cache_lookup (filename, error);
+
+  if (!entry)
+    return COGL_INVALID_HANDLE;
+
+  return cogl_handle_ref (entry->texture);
+}
+
+CoglHandle
+glide_texture_cache_lookup_texture (const gchar *filename, guint scale)
+{
+  GlideTextureCacheEntry *entry;
+  gchar *key = glide_texture_cache_make_key (filename, scale);
+
+  entry = glide_texture_cache_find (key);
+  g_free (key);
+
+  if (!entry)
+    return COGL_INVALID_HANDLE;
+
+  return cogl_handle_ref (entry->texture);
+}
+
+void
+glide_texture_cache_insert_texture (const gchar *filename, guint scale, CoglHandle texture)
+{
+  gchar *key = glide_texture_cache_make_key (filename, scale);
+
+  if (glide_texture_cache_find (key))
+    {
+      g_free (key);
+      return;
+    }
+
+  cache_misses++;
+  glide_texture_cache_add (key, cogl_handle_ref (texture));
+}
+
+CoglHandle
+glide_texture_cache_get_material (const gchar *filename, GError **error)
+{
+  GlideTextureCacheEntry *entry = glide_texture_cache_lookup (filename, error);
+
+  if (!entry)
+    return COGL_INVALID_HANDLE;
+
+  if (entry->material == COGL_INVALID_HANDLE)
+    {
+      entry->material = cogl_material_new ();
+      cogl_material_set_layer (entry->material, 0, entry->texture);
+      cogl_material_set_layer_filters (entry->material, 0,
+				       COGL_MATERIAL_FILTER_LINEAR_MIPMAP_LINEAR,
+				       COGL_MATERIAL_FILTER_LINEAR);
+    }
+
+  return cogl_handle_ref (entry->material);
+}
+
+void
+glide_texture_cache_set_budget (gsize budget)
+{
+  cache_budget = budget;
+
+  glide_texture_cache_evict (NULL);
+}
+
+gsize
+glide_texture_cache_get_budget (void)
+{
+  return cache_budget;
+}
+
+gsize
+glide_texture_cache_get_size (void)
+{
+  return cache_size;
+}
+
+guint
+glide_texture_cache_get_hits (void)
+{
+  return cache_hits;
+}
+
+guint
+glide_texture_cache_get_misses (void)
+{
+  return cache_misses;
+}
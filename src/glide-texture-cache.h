@@ -0,0 +1,53 @@
+/*
+ * glide-texture-cache.h
+ * This file is part of glide
+ *
+ * Copyright (C) 2010 - Robert Carr
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef __GLIDE_TEXTURE_CACHE_H__
+#define __GLIDE_TEXTURE_CACHE_H__
+
+#include <glib.h>
+#include <cogl/cogl.h>
+
+G_BEGIN_DECLS
+
+/* Both return a new reference, or COGL_INVALID_HANDLE on error */
+CoglHandle glide_texture_cache_get_texture (const gchar *filename, GError **error);
+CoglHandle glide_texture_cache_get_material (const gchar *filename, GError **error);
+
+/* 
+ * For textures decoded elsewhere, lookup never loads from disk. Scale
+ * is the downscale factor of the texture, 1 for the full image.
+ */
+CoglHandle glide_texture_cache_lookup_texture (const gchar *filename, guint scale);
+void glide_texture_cache_insert_texture (const gchar *filename, guint scale, CoglHandle texture);
+
+void glide_texture_cache_set_budget (gsize budget);
+gsize glide_texture_cache_get_budget (void);
+
+gsize glide_texture_cache_get_size (void);
+
+guint glide_texture_cache_get_hits (void);
+guint glide_texture_cache_get_misses (void);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,414 @@
+/*
+ * glide-thumbnail-cache.c
+ * This file is part of glide
+ *
+ * Copyright (C) 2010 - Robert Carr
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <glib/gstdio.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "glide-thumbnail-cache.h"
+
+#include "glide-export.h"
+#include "glide-cairo-util.h"
+#include "glide-dirs.h"
+
+#include "glide-debug.h"
+
+#define THUMBNAIL_CACHE_MAX_ENTRIES 256
+
+#define THUMBNAIL_CACHE_MAX_AGE (30 * 24 * 60 * 60)
+#define THUMBNAIL_CACHE_MAX_BYTES (64 * 1024 * 1024)
+
+/*
+ * Thumbnails are keyed by the checksum of the slide and their size, so
+ * an edited slide simply misses. The most recently used ones stay in
+ * memory, and every thumbnail is written as a PNG under the user cache
+ * directory, which outlives the process. The disk is only ever touched
+ * from a thread. Files are touched as they are read, and once per run
+ * those unused for THUMBNAIL_CACHE_MAX_AGE are removed, then the oldest
+ * until THUMBNAIL_CACHE_MAX_BYTES are left.
+ */
+typedef struct _GlideThumbnailCacheEntry {
+  gchar *key;
+  GdkPixbuf *pixbuf;
+  
+  GList *link;
+} GlideThumbnailCacheEntry;
+
+typedef struct _GlideThumbnailWriteJob {
+  gchar *path;
+  GdkPixbuf *pixbuf;
+} GlideThumbnailWriteJob;
+
+typedef struct _GlideThumbnailReadJob {
+  gchar *key;
+  gchar *path;
+  GdkPixbuf *pixbuf;
+  
+  GlideThumbnailCacheLoadFunc func;
+  gpointer user_data;
+} GlideThumbnailReadJob;
+
+static GHashTable *thumbnail_entries = NULL;
+static GQueue thumbnail_lru = G_QUEUE_INIT;
+
+static GThreadPool *write_pool = NULL;
+static GThreadPool *read_pool = NULL;
+
+static void
+glide_thumbnail_cache_entry_free (gpointer data)
+{
+  GlideThumbnailCacheEntry *entry = (GlideThumbnailCacheEntry *)data;
+  
+  g_object_unref (entry->pixbuf);
+  g_free (entry->key);
+  g_slice_free (GlideThumbnailCacheEntry, entry);
+}
+
+static gchar *
+glide_thumbnail_cache_make_key (const gchar *checksum, gint width, gint height)
+{
+  return g_strdup_printf ("%s-%dx%d", checksum, width, height);
+}
+
+static gchar *
+glide_thumbnail_cache_get_dir (void)
+{
+  gchar *cache_dir = glide_dirs_get_glide_cache_dir ();
+  gchar *dir = g_build_filename (cache_dir, "thumbnails", NULL);
+  
+  g_free (cache_dir);
+  
+  return dir;
+}
+
+static gchar *
+glide_thumbnail_cache_get_path (const gchar *key)
+{
+  gchar *dir = glide_thumbnail_cache_get_dir ();
+  gchar *name = g_strconcat (key, ".png", NULL);
+  gchar *path = g_build_filename (dir, name, NULL);
+  
+  g_free (dir);
+  g_free (name);
+  
+  return path;
+}
+
+typedef struct _GlideThumbnailFile {
+  gchar *path;
+  time_t mtime;
+  off_t size;
+} GlideThumbnailFile;
+
+static gint
+glide_thumbnail_file_compare_age (gconstpointer a, gconstpointer b)
+{
+  const GlideThumbnailFile *fa = a, *fb = b;
+  
+  return (fa->mtime > fb->mtime) - (fa->mtime < fb->mtime);
+}
+
+static void
+glide_thumbnail_cache_prune (void)
+{
+  gchar *dir_path = glide_thumbnail_cache_get_dir ();
+  GDir *dir = g_dir_open (dir_path, 0, NULL);
+  GList *files = NULL, *f;
+  const gchar *name;
+  time_t now = time (NULL);
+  guint64 total = 0;
+  guint n_removed = 0;
+  
+  if (!dir)
+    {
+      g_free (dir_path);
+      return;
+    }
+  
+  while ((name = g_dir_read_name (dir)))
+    {
+      gchar *path = g_build_filename (dir_path, name, NULL);
+      struct stat st;
+      
+      if (g_stat (path, &st) != 0 || !S_ISREG (st.st_mode))
+	{
+	  g_free (path);
+	  continue;
+	}
+      
+      if (now - st.st_mtime > THUMBNAIL_CACHE_MAX_AGE)
+	{
+	  g_unlink (path);
+	  g_free (path);
+	  n_removed++;
+	}
+      else
+	{
+	  GlideThumbnailFile *file = g_slice_new (GlideThumbnailFile);
+	  
+	  file->path = path;
+	  file->mtime = st.st_mtime;
+	  file->size = st.st_size;
+	  files = g_list_prepend (files, file);
+	  total += st.st_size;
+	}
+    }
+  g_dir_close (dir);
+  
+  files = g_list_sort (files, glide_thumbnail_file_compare_age);
+  for (f = files; f; f = f->next)
+    {
+      GlideThumbnailFile *file = (GlideThumbnailFile *)f->data;
+      
+      if (total > THUMBNAIL_CACHE_MAX_BYTES)
+	{
+	  g_unlink (file->path);
+	  total -= file->size;
+	  n_removed++;
+	}
+      g_free (file->path);
+      g_slice_free (GlideThumbnailFile, file);
+    }
+  g_list_free (files);
+  
+  GLIDE_NOTE (IMAGE, "Pruned %u thumbnails from %s", n_removed, dir_path);
+  
+  g_free (dir_path);
+}
+
+/*
+ * Writes to a temporary file first, so readers never see half a PNG.
+ * A job without a path prunes the cache instead.
+ */
+static void
+glide_thumbnail_cache_write_func (gpointer data, gpointer user_data)
+{
+  GlideThumbnailWriteJob *job = (GlideThumbnailWriteJob *)data;
+  gchar *dir, *tmp;
+  GError *e = NULL;
+  
+  if (!job->path)
+    {
+      glide_thumbnail_cache_prune ();
+      g_slice_free (GlideThumbnailWriteJob, job);
+      return;
+    }
+  
+  dir = g_path_get_dirname (job->path);
+  tmp = g_strconcat (job->path, ".tmp", NULL);
+  
+  g_mkdir_with_parents (dir, 0700);
+  
+  if (gdk_pixbuf_save (job->pixbuf, tmp, "png", &e, NULL))
+    g_rename (tmp, job->path);
+  else
+    {
+      g_warning ("Failed to write thumbnail %s: %s", job->path, e->message);
+      g_error_free (e);
+      g_unlink (tmp);
+    }
+  
+  g_free (tmp);
+  g_free (dir);
+  g_free (job->path);
+  g_object_unref (job->pixbuf);
+  g_slice_free (GlideThumbnailWriteJob, job);
+}
+
+static void
+glide_thumbnail_cache_add (gchar *key, GdkPixbuf *pixbuf)
+{
+  GlideThumbnailCacheEntry *entry = g_slice_new0 (GlideThumbnailCacheEntry);
+  
+  entry->key = key;
+  entry->pixbuf = g_object_ref (pixbuf);
+  
+  g_queue_push_head (&thumbnail_lru, entry);
+  entry->link = thumbnail_lru.head;
+  g_hash_table_insert (thumbnail_entries, entry->key, entry);
+  
+  while (thumbnail_lru.length > THUMBNAIL_CACHE_MAX_ENTRIES)
+    {
+      GlideThumbnailCacheEntry *oldest = g_queue_pop_tail (&thumbnail_lru);
+      
+      g_hash_table_remove (thumbnail_entries, oldest->key);
+    }
+}
+
+static GdkPixbuf *
+glide_thumbnail_cache_find (const gchar *key)
+{
+  GlideThumbnailCacheEntry *entry;
+  
+  if (!thumbnail_entries)
+    thumbnail_entries = g_hash_table_new_full (g_str_hash, g_str_equal,
+					       NULL, glide_thumbnail_cache_entry_free);
+  
+  if ((entry = g_hash_table_lookup (thumbnail_entries, key)))
+    {
+      g_queue_unlink (&thumbnail_lru, entry->link);
+      g_queue_push_head_link (&thumbnail_lru, entry->link);
+      
+      return g_object_ref (entry->pixbuf);
+    }
+  
+  return NULL;
+}
+
+static gboolean
+glide_thumbnail_cache_read_done (gpointer data)
+{
+  GlideThumbnailReadJob *job = (GlideThumbnailReadJob *)data;
+  GdkPixbuf *pixbuf;
+  
+  // In memory already, or rendered while it was being read.
+  pixbuf = glide_thumbnail_cache_find (job->key);
+  if (!pixbuf && job->pixbuf)
+    {
+      GLIDE_NOTE (IMAGE, "Loaded thumbnail %s from disk", job->key);
+      
+      glide_thumbnail_cache_add (job->key, job->pixbuf);
+      job->key = NULL;
+      pixbuf = g_object_ref (job->pixbuf);
+    }
+  if (job->pixbuf)
+    g_object_unref (job->pixbuf);
+  
+  job->func (pixbuf, job->user_data);
+  
+  if (pixbuf)
+    g_object_unref (pixbuf);
+  g_free (job->key);
+  g_free (job->path);
+  g_slice_free (GlideThumbnailReadJob, job);
+  
+  return FALSE;
+}
+
+static void
+glide_thumbnail_cache_read_func (gpointer data, gpointer user_data)
+{
+  GlideThumbnailReadJob *job = (GlideThumbnailReadJob *)data;
+  
+  job->pixbuf = gdk_pixbuf_new_from_file (job->path, NULL);
+  
+  // Keeps it from being pruned as unused.
+  if (job->pixbuf)
+    g_utime (job->path, NULL);
+  
+  g_idle_add (glide_thumbnail_cache_read_done, job);
+}
+
+GdkPixbuf *
+glide_thumbnail_cache_lookup (const gchar *checksum, gint width, gint height)
+{
+  gchar *key = glide_thumbnail_cache_make_key (checksum, width, height);
+  GdkPixbuf *pixbuf = glide_thumbnail_cache_find (key);
+  
+  g_free (key);
+  
+  return pixbuf;
+}
+
+/*
+ * Looks for the thumbnail in memory, then on disk from a thread. func
+ * is called from the main loop with the thumbnail, or NULL if there is
+ * none, in which case it is up to the caller to render one.
+ */
+void
+glide_thumbnail_cache_load (const gchar *checksum,
+			    gint width,
+			    gint height,
+			    GlideThumbnailCacheLoadFunc func,
+			    gpointer user_data)
+{
+  GlideThumbnailReadJob *job = g_slice_new0 (GlideThumbnailReadJob);
+  GdkPixbuf *pixbuf;
+  
+  job->key = glide_thumbnail_cache_make_key (checksum, width, height);
+  job->func = func;
+  job->user_data = user_data;
+  
+  // Still through the main loop, so func is always called the same way.
+  if ((pixbuf = glide_thumbnail_cache_find (job->key)))
+    {
+      g_object_unref (pixbuf);
+      g_idle_add (glide_thumbnail_cache_read_done, job);
+      return;
+    }
+  
+  job->path = glide_thumbnail_cache_get_path (job->key);
+  
+  if (!read_pool)
+    read_pool = g_thread_pool_new (glide_thumbnail_cache_read_func, NULL, 1, FALSE, NULL);
+  g_thread_pool_push (read_pool, job, NULL);
+}
+
+/*
+ * Renders slide on a miss in memory, so it has to be called from the
+ * main thread, and doesn't look on disk, see glide_thumbnail_cache_load.
+ * checksum is that of glide_slide_get_checksum, passed in as callers
+ * usually have it already.
+ */
+GdkPixbuf *
+glide_thumbnail_cache_get (GlideSlide *slide,
+			   const gchar *checksum,
+			   gint width,
+			   gint height)
+{
+  gchar *key = glide_thumbnail_cache_make_key (checksum, width, height);
+  GlideThumbnailWriteJob *job;
+  cairo_surface_t *surface;
+  GdkPixbuf *pixbuf;
+  
+  if ((pixbuf = glide_thumbnail_cache_find (key)))
+    {
+      g_free (key);
+      return pixbuf;
+    }
+  
+  surface = glide_export_draw_slide (slide, width, height);
+  if (!surface)
+    {
+      g_free (key);
+      return NULL;
+    }
+  pixbuf = glide_cairo_util_surface_to_pixbuf (surface);
+  cairo_surface_destroy (surface);
+  
+  GLIDE_NOTE (IMAGE, "Rendered thumbnail %s", key);
+  
+  job = g_slice_new (GlideThumbnailWriteJob);
+  job->path = glide_thumbnail_cache_get_path (key);
+  job->pixbuf = g_object_ref (pixbuf);
+  
+  if (!write_pool)
+    {
+      write_pool = g_thread_pool_new (glide_thumbnail_cache_write_func, NULL, 1, FALSE, NULL);
+      g_thread_pool_push (write_pool, g_slice_new0 (GlideThumbnailWriteJob), NULL);
+    }
+  g_thread_pool_push (write_pool, job, NULL);
+  
+  glide_thumbnail_cache_add (key, pixbuf);
+  
+  return pixbuf;
+}
@@ -0,0 +1,44 @@
+/*
+ * glide-thumbnail-cache.h
+ * This file is part of glide
+ *
+ * Copyright (C) 2010 - Robert Carr
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GLIDE_THUMBNAIL_CACHE_H__
+#define __GLIDE_THUMBNAIL_CACHE_H__
+
+#include <glib.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include "glide-slide.h"
+
+G_BEGIN_DECLS
+
+typedef void (*GlideThumbnailCacheLoadFunc) (GdkPixbuf *pixbuf, gpointer user_data);
+
+/* Both return a new reference. Lookup only looks in memory, and returns NULL on a miss */
+GdkPixbuf *glide_thumbnail_cache_lookup (const gchar *checksum, gint width, gint height);
+void glide_thumbnail_cache_load (const gchar *checksum, gint width, gint height,
+				 GlideThumbnailCacheLoadFunc func, gpointer user_data);
+GdkPixbuf *glide_thumbnail_cache_get (GlideSlide *slide, const gchar *checksum,
+				      gint width, gint height);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,255 @@
+/*
+ * glide-transition-stats.c
+ * This file is part of glide
+ *
+ * Copyright (C) 2010 - Robert Carr
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, 
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+
+#include <json-glib/json-glib.h>
+
+#include "glide-transition-stats.h"
+#include "glide-animations.h"
+
+#include "glide-debug.h"
+
+/*
+ * Collects the frame times of each transition from
+ * glide_animations_run, leaving out transitions which were cut short.
+ * A frame taking more than one and a half intervals of the default
+ * frame rate counts the intervals it missed as dropped frames.
+ */
+typedef struct _GlideTransitionRecord {
+  const gchar *animation;
+  guint slide;
+  gdouble duration;
+  
+  /* Milliseconds between consecutive frames */
+  GArray *frame_times;
+  guint dropped;
+} GlideTransitionRecord;
+
+static gchar *stats_output = NULL;
+static GList *stats_records = NULL;
+
+static void
+glide_transition_stats_run_notify (GlideAnimationInfo *info,
+				   ClutterTimeline *timeline,
+				   GArray *frame_times,
+				   gdouble duration,
+				   gpointer user_data)
+{
+  GlideTransitionRecord *record;
+  gdouble interval = 1000.0 / clutter_get_default_frame_rate ();
+  gpointer slide = g_object_get_data (G_OBJECT (timeline), "glide-transition-slide");
+  guint i;
+  
+  if (!slide)
+    return;
+  
+  record = g_new0 (GlideTransitionRecord, 1);
+  record->animation = info->name;
+  record->slide = GPOINTER_TO_UINT (slide) - 1;
+  record->duration = duration;
+  record->frame_times = g_array_sized_new (FALSE, FALSE, sizeof (gdouble), frame_times->len);
+  g_array_append_vals (record->frame_times, frame_times->data, frame_times->len);
+  
+  for (i = 0; i < frame_times->len; i++)
+    {
+      gdouble delta = g_array_index (frame_times, gdouble, i);
+      
+      if (delta > 1.5 * interval)
+	record->dropped += (guint) floor (delta / interval + 0.5) - 1;
+    }
+  
+  stats_records = g_list_append (stats_records, record);
+  
+  GLIDE_NOTE (PAINT, "Recorded %s on slide %u: %u frames, %u dropped",
+	      record->animation, record->slide, record->frame_times->len, record->dropped);
+}
+
+void
+glide_transition_stats_set_output (const gchar *filename)
+{
+  g_free (stats_output);
+  stats_output = g_strdup (filename);
+  
+  glide_animations_set_run_notify (stats_output ? glide_transition_stats_run_notify : NULL, NULL);
+}
+
+gboolean
+glide_transition_stats_get_enabled (void)
+{
+  return stats_output != NULL;
+}
+
+/* Marks timeline, from glide_animations_run, as the transition away from slide */
+void
+glide_transition_stats_watch (ClutterTimeline *timeline,
+			      guint slide)
+{
+  if (!stats_output)
+    return;
+  
+  g_object_set_data (G_OBJECT (timeline), "glide-transition-slide", GUINT_TO_POINTER (slide + 1));
+}
+
+static gint
+glide_transition_stats_compare_times (gconstpointer a, gconstpointer b)
+{
+  gdouble da = *(const gdouble *)a, db = *(const gdouble *)b;
+  
+  return (da > db) - (da < db);
+}
+
+static gdouble
+glide_transition_stats_percentile (GArray *sorted, gdouble p)
+{
+  gint i;
+  
+  if (!sorted->len)
+    return 0;
+  
+  i = (gint) ceil (p / 100.0 * sorted->len) - 1;
+  return g_array_index (sorted, gdouble, CLAMP (i, 0, (gint) sorted->len - 1));
+}
+
+static JsonNode *
+glide_transition_stats_summarize (GArray *frame_times, guint dropped)
+{
+  JsonNode *node = json_node_new (JSON_NODE_OBJECT);
+  JsonObject *obj = json_object_new ();
+  GArray *sorted;
+  
+  json_node_take_object (node, obj);
+  
+  sorted = g_array_sized_new (FALSE, FALSE, sizeof (gdouble), frame_times->len);
+  g_array_append_vals (sorted, frame_times->data, frame_times->len);
+  g_array_sort (sorted, glide_transition_stats_compare_times);
+  
+  json_object_set_int_member (obj, "frames", frame_times->len);
+  json_object_set_int_member (obj, "dropped-frames", dropped);
+  json_object_set_double_member (obj, "p50", glide_transition_stats_percentile (sorted, 50));
+  json_object_set_double_member (obj, "p95", glide_transition_stats_percentile (sorted, 95));
+  json_object_set_double_member (obj, "p99", glide_transition_stats_percentile (sorted, 99));
+  json_object_set_double_member (obj, "max",
+				 sorted->len ? g_array_index (sorted, gdouble, sorted->len - 1) : 0);
+  
+  g_array_free (sorted, TRUE);
+  
+  return node;
+}
+
+static void
+glide_transition_stats_record_free (GlideTransitionRecord *record)
+{
+  g_array_free (record->frame_times, TRUE);
+  g_free (record);
+}
+
+/*
+ * Writes the transitions recorded since the last write to the output
+ * file as JSON, one summary per transition and one per animation.
+ * Frame times are in milliseconds.
+ */
+gboolean
+glide_transition_stats_write (GError **error)
+{
+  JsonGenerator *gen;
+  JsonNode *root, *transitions_node, *animations_node;
+  JsonObject *root_obj, *animations;
+  JsonArray *transitions;
+  GHashTable *per_animation, *per_animation_dropped;
+  GHashTableIter iter;
+  gpointer key, value;
+  GList *r;
+  gboolean ret;
+  
+  if (!stats_output)
+    return TRUE;
+  
+  root = json_node_new (JSON_NODE_OBJECT);
+  root_obj = json_object_new ();
+  json_node_take_object (root, root_obj);
+  
+  transitions_node = json_node_new (JSON_NODE_ARRAY);
+  transitions = json_array_new ();
+  json_node_take_array (transitions_node, transitions);
+  
+  per_animation = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+					 (GDestroyNotify) g_array_unref);
+  per_animation_dropped = g_hash_table_new (g_str_hash, g_str_equal);
+  
+  for (r = stats_records; r; r = r->next)
+    {
+      GlideTransitionRecord *record = (GlideTransitionRecord *)r->data;
+      JsonNode *n;
+      GArray *times;
+      
+      n = glide_transition_stats_summarize (record->frame_times, record->dropped);
+      json_object_set_string_member (json_node_get_object (n), "animation", record->animation);
+      json_object_set_int_member (json_node_get_object (n), "slide", record->slide);
+      json_object_set_double_member (json_node_get_object (n), "duration", record->duration);
+      json_array_add_element (transitions, n);
+      
+      if (!(times = g_hash_table_lookup (per_animation, record->animation)))
+	{
+	  times = g_array_new (FALSE, FALSE, sizeof (gdouble));
+	  g_hash_table_insert (per_animation, (gpointer) record->animation, times);
+	}
+      g_array_append_vals (times, record->frame_times->data, record->frame_times->len);
+      
+      g_hash_table_insert (per_animation_dropped, (gpointer) record->animation,
+			   GUINT_TO_POINTER (GPOINTER_TO_UINT (g_hash_table_lookup (per_animation_dropped, record->animation)) + record->dropped));
+      
+      glide_transition_stats_record_free (record);
+    }
+  g_list_free (stats_records);
+  stats_records = NULL;
+  
+  animations_node = json_node_new (JSON_NODE_OBJECT);
+  animations = json_object_new ();
+  json_node_take_object (animations_node, animations);
+  
+  g_hash_table_iter_init (&iter, per_animation);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    json_object_set_member (animations, (const gchar *)key,
+			    glide_transition_stats_summarize ((GArray *)value,
+							      GPOINTER_TO_UINT (g_hash_table_lookup (per_animation_dropped, key))));
+  
+  json_object_set_double_member (root_obj, "frame-interval", 1000.0 / clutter_get_default_frame_rate ());
+  json_object_set_member (root_obj, "transitions", transitions_node);
+  json_object_set_member (root_obj, "animations", animations_node);
+  
+  gen = json_generator_new ();
+  g_object_set (gen, "pretty", TRUE, NULL);
+  json_generator_set_root (gen, root);
+  
+  ret = json_generator_to_file (gen, stats_output, error);
+  
+  GLIDE_NOTE (MISC, "Wrote transition statistics to %s", stats_output);
+  
+  g_object_unref (gen);
+  json_node_free (root);
+  g_hash_table_destroy (per_animation);
+  g_hash_table_destroy (per_animation_dropped);
+  
+  return ret;
+}
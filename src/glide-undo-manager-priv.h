@@ -27,16 +27,38 @@
 
 G_BEGIN_DECLS
 
+/* 
+ * The properties an actor action can change. Text is only held while
+ * an action is recorded, the undo record keeps the changed range.
+ */
+typedef struct _GlideUndoActorState {
+  gfloat x, y;
+  gfloat width, height;
+  
+  gchar *text;
+  gchar *font_name;
+  ClutterColor color;
+  PangoAlignment alignment;
+} GlideUndoActorState;
+
 struct _GlideUndoManagerPrivate
 {
   ClutterActor *recorded_actor;
-  // TODO: Check. do we leak the nodes?...maybe this should be in
-  // GlideActor too..
-  JsonObject *recorded_state;
+  GlideUndoActorState *recorded_state;
   gchar *recorded_label;
 
   GList *infos;
   GList *position;
+  
+  guint n_entries;
+  gulong history_size;
+  
+  guint max_entries;
+  gulong max_bytes;
+  
+  /* The last entry, while further nudges can be merged into it */
+  GlideUndoInfo *coalesce_info;
+  gint64 coalesce_time;
 };
 
 G_END_DECLS
@@ -20,9 +20,14 @@
  * Boston, MA 02111-1307, USA.
  */
 
+#include <string.h>
+
 #include "glide-undo-manager.h"
 #include "glide-stage-manager.h"
 #include "glide-actor.h"
+#include "glide-text.h"
+#include "glide-image.h"
+#include "glide-slide.h"
 
 #include "glide-undo-manager-priv.h"
 
@@ -34,11 +39,25 @@ G_DEFINE_TYPE(GlideUndoManager, glide_undo_manager, G_TYPE_OBJECT)
 
 #define GLIDE_UNDO_MANAGER_GET_PRIVATE(object)(G_TYPE_INSTANCE_GET_PRIVATE ((object), GLIDE_TYPE_UNDO_MANAGER, GlideUndoManagerPrivate))
 
+#define DEFAULT_MAX_ENTRIES 200
+#define DEFAULT_MAX_BYTES (32 * 1024 * 1024)
+
+// Nudges further apart than this start a new entry.
+#define COALESCE_TIMEOUT_USEC (G_USEC_PER_SEC)
+
 enum {
   POSITION_CHANGED,
+  OPERATION,
   LAST_SIGNAL
 };
 
+enum {
+  PROP_0,
+  PROP_MAX_ENTRIES,
+  PROP_MAX_BYTES,
+  PROP_HISTORY_SIZE
+};
+
 static guint undo_manager_signals[LAST_SIGNAL] = { 0, };
 
 static GList *
@@ -55,6 +74,20 @@ glide_undo_manager_free_undo_info (GList *list)
   return list->next;
 }
 
+/* Deleted actors are kept alive by the history, so count what they hold */
+static gsize
+glide_undo_estimate_actor_size (ClutterActor *actor)
+{
+  gsize size = 1024;
+  
+  if (GLIDE_IS_IMAGE (actor))
+    size += glide_image_get_texture_memory (GLIDE_IMAGE (actor));
+  else if (GLIDE_IS_TEXT (actor) && glide_text_get_text (GLIDE_TEXT (actor)))
+    size += strlen (glide_text_get_text (GLIDE_TEXT (actor)));
+  
+  return size;
+}
+
 typedef struct _GlideUndoDeleteActorData {
   ClutterActor *parent;
   ClutterActor *actor;
@@ -104,21 +137,203 @@ glide_undo_delete_actor_redo_callback (GlideUndoManager *undo_manager,
   return TRUE;
 }
 
+enum {
+  GLIDE_UNDO_ACTOR_GEOMETRY = 1 << 0,
+  GLIDE_UNDO_ACTOR_TEXT = 1 << 1,
+  GLIDE_UNDO_ACTOR_FONT = 1 << 2,
+  GLIDE_UNDO_ACTOR_COLOR = 1 << 3,
+  GLIDE_UNDO_ACTOR_ALIGNMENT = 1 << 4
+};
+
+/*
+ * Only the properties which changed are restored. Text edits keep the
+ * replaced range, starting at text_offset (in characters), or the whole
+ * text with full_text.
+ */
 typedef struct _GlideUndoActorData {
   ClutterActor *actor;
+  guint changed;
 
-  JsonObject *old_state;
-  JsonObject *new_state;
+  GlideUndoActorState old_state;
+  GlideUndoActorState new_state;
+  
+  gboolean full_text;
+  glong text_offset;
+  gchar *old_text;
+  gchar *new_text;
 } GlideUndoActorData;
 
+static GlideUndoActorState *
+glide_undo_actor_state_new (ClutterActor *actor)
+{
+  GlideUndoActorState *state = g_slice_new0 (GlideUndoActorState);
+  
+  clutter_actor_get_position (actor, &state->x, &state->y);
+  clutter_actor_get_size (actor, &state->width, &state->height);
+  
+  if (GLIDE_IS_TEXT (actor))
+    {
+      GlideText *text = GLIDE_TEXT (actor);
+      
+      state->text = g_strdup (glide_text_get_text (text));
+      state->font_name = g_strdup (glide_text_get_font_name (text));
+      glide_text_get_color (text, &state->color);
+      state->alignment = glide_text_get_line_alignment (text);
+    }
+  
+  return state;
+}
+
+static void
+glide_undo_actor_state_free (GlideUndoActorState *state)
+{
+  g_free (state->text);
+  g_free (state->font_name);
+  
+  g_slice_free (GlideUndoActorState, state);
+}
+
+/* Finds the differing run between two strings, in whole characters */
+static void
+glide_undo_actor_data_diff_text (GlideUndoActorData *data,
+				 const gchar *old_text,
+				 const gchar *new_text)
+{
+  const gchar *o = old_text, *n = new_text;
+  const gchar *oe = old_text + strlen (old_text);
+  const gchar *ne = new_text + strlen (new_text);
+  
+  while (o < oe && n < ne && g_utf8_get_char (o) == g_utf8_get_char (n))
+    {
+      o = g_utf8_next_char (o);
+      n = g_utf8_next_char (n);
+    }
+  while (oe > o && ne > n)
+    {
+      const gchar *op = g_utf8_prev_char (oe);
+      const gchar *np = g_utf8_prev_char (ne);
+      
+      if (g_utf8_get_char (op) != g_utf8_get_char (np))
+	break;
+      oe = op;
+      ne = np;
+    }
+  
+  data->text_offset = g_utf8_pointer_to_offset (old_text, o);
+  data->old_text = g_strndup (o, oe - o);
+  data->new_text = g_strndup (n, ne - n);
+}
+
+/*
+ * Diffs only hold while the text changes through the undo manager, so
+ * each text actor carries a hash of the text as of its last record.
+ */
+#define TEXT_HASH_KEY "glide-undo-text-hash"
+
+static guint
+glide_undo_text_hash (const gchar *text)
+{
+  // Never 0, which is no hash at all.
+  return g_str_hash (text ? text : "") | 1;
+}
+
+static void
+glide_undo_text_remember (ClutterActor *actor, const gchar *text)
+{
+  g_object_set_data (G_OBJECT (actor), TEXT_HASH_KEY,
+		     GUINT_TO_POINTER (glide_undo_text_hash (text)));
+}
+
+/* Replaces the run at text_offset, which should hold remove, with insert */
+static void
+glide_undo_actor_data_apply_text (GlideUndoActorData *data,
+				  const gchar *remove,
+				  const gchar *insert)
+{
+  GlideText *text = GLIDE_TEXT (data->actor);
+  const gchar *current = glide_text_get_text (text);
+  const gchar *p;
+  GString *s;
+  
+  if (data->full_text)
+    {
+      glide_text_set_text (text, insert);
+      glide_undo_text_remember (data->actor, insert);
+      return;
+    }
+  
+  if (!current)
+    current = "";
+  if (data->text_offset > g_utf8_strlen (current, -1) ||
+      strncmp ((p = g_utf8_offset_to_pointer (current, data->text_offset)),
+	       remove, strlen (remove)))
+    {
+      g_warning ("Text changed outside of the undo history, not restoring it");
+      return;
+    }
+  
+  s = g_string_new_len (current, p - current);
+  g_string_append (s, insert);
+  g_string_append (s, p + strlen (remove));
+  
+  glide_text_set_text (text, s->str);
+  glide_undo_text_remember (data->actor, s->str);
+  
+  g_string_free (s, TRUE);
+}
+
+static void
+glide_undo_manager_actor_changed (ClutterActor *actor)
+{
+  ClutterActor *parent;
+  
+  for (parent = clutter_actor_get_parent (actor); parent;
+       parent = clutter_actor_get_parent (parent))
+    if (GLIDE_IS_SLIDE (parent))
+      {
+	glide_slide_mark_dirty (GLIDE_SLIDE (parent));
+	return;
+      }
+}
+
+static void
+glide_undo_actor_data_apply (GlideUndoActorData *data, gboolean undo)
+{
+  GlideUndoActorState *state = undo ? &data->old_state : &data->new_state;
+  
+  if (data->changed & GLIDE_UNDO_ACTOR_GEOMETRY)
+    {
+      clutter_actor_set_size (data->actor, state->width, state->height);
+      clutter_actor_set_position (data->actor, state->x, state->y);
+    }
+  if (data->changed & GLIDE_UNDO_ACTOR_TEXT)
+    {
+      if (undo)
+	glide_undo_actor_data_apply_text (data, data->new_text, data->old_text);
+      else
+	glide_undo_actor_data_apply_text (data, data->old_text, data->new_text);
+    }
+  if (data->changed & GLIDE_UNDO_ACTOR_FONT)
+    glide_text_set_font_name (GLIDE_TEXT (data->actor), state->font_name);
+  if (data->changed & GLIDE_UNDO_ACTOR_COLOR)
+    glide_text_set_color (GLIDE_TEXT (data->actor), &state->color);
+  if (data->changed & GLIDE_UNDO_ACTOR_ALIGNMENT)
+    glide_text_set_line_alignment (GLIDE_TEXT (data->actor), state->alignment);
+  
+  glide_undo_manager_actor_changed (data->actor);
+}
+
 static void
 glide_undo_actor_info_free_callback (GlideUndoInfo *info)
 {
   GlideUndoActorData *data = (GlideUndoActorData *)info->user_data;
   
   g_object_unref (G_OBJECT (data->actor));
-  json_object_unref (data->old_state);
-  json_object_unref (data->new_state);
+  
+  g_free (data->old_state.font_name);
+  g_free (data->new_state.font_name);
+  g_free (data->old_text);
+  g_free (data->new_text);
   
   g_free (data);
 }
@@ -129,7 +344,7 @@ glide_undo_actor_action_undo_callback (GlideUndoManager *undo_manager,
 {
   GlideUndoActorData *data = (GlideUndoActorData *)info->user_data;
   
-  glide_actor_deserialize (GLIDE_ACTOR (data->actor), data->old_state);
+  glide_undo_actor_data_apply (data, TRUE);
 							      
   return TRUE;
 }
@@ -140,7 +355,7 @@ glide_undo_actor_action_redo_callback (GlideUndoManager *undo_manager,
 {
   GlideUndoActorData *data = (GlideUndoActorData *)info->user_data;
   
-  glide_actor_deserialize (GLIDE_ACTOR (data->actor), data->new_state);
+  glide_undo_actor_data_apply (data, FALSE);
 							      
   return TRUE;
 }
@@ -150,11 +365,11 @@ glide_undo_manager_start_actor_action (GlideUndoManager *manager,
 				       GlideActor *a,
 				       const gchar *label)
 {
-  JsonNode *anode;
-  manager->priv->recorded_actor = (ClutterActor *)a;
+  if (manager->priv->recorded_state)
+    glide_undo_manager_cancel_actor_action (manager);
   
-  anode = glide_actor_serialize (a);
-  manager->priv->recorded_state = json_node_get_object (anode);
+  manager->priv->recorded_actor = (ClutterActor *)a;
+  manager->priv->recorded_state = glide_undo_actor_state_new ((ClutterActor *)a);
   
   manager->priv->recorded_label = g_strdup (label);
 }
@@ -162,19 +377,54 @@ glide_undo_manager_start_actor_action (GlideUndoManager *manager,
 void
 glide_undo_manager_cancel_actor_action (GlideUndoManager *manager)
 {
+  if (manager->priv->recorded_state)
+    glide_undo_actor_state_free (manager->priv->recorded_state);
+  
   manager->priv->recorded_actor = NULL;
   manager->priv->recorded_state = NULL;
   
   g_free (manager->priv->recorded_label);
+  manager->priv->recorded_label = NULL;
 }
 
-void
-glide_undo_manager_end_actor_action (GlideUndoManager *manager,
-				     GlideActor *a)
+static gboolean
+glide_undo_manager_coalesce (GlideUndoManager *manager,
+			     GlideActor *a,
+			     GlideUndoActorData *data,
+			     const gchar *label,
+			     gint64 now)
+{
+  GlideUndoInfo *info = manager->priv->coalesce_info;
+  GlideUndoActorData *last;
+  
+  if (!info || !manager->priv->position || manager->priv->position->data != info)
+    return FALSE;
+  
+  last = (GlideUndoActorData *)info->user_data;
+  if (last->actor != (ClutterActor *)a || strcmp (info->label, label) ||
+      last->changed != GLIDE_UNDO_ACTOR_GEOMETRY || data->changed != GLIDE_UNDO_ACTOR_GEOMETRY)
+    return FALSE;
+  
+  if (now - manager->priv->coalesce_time > COALESCE_TIMEOUT_USEC)
+    return FALSE;
+  
+  last->new_state.x = data->new_state.x;
+  last->new_state.y = data->new_state.y;
+  last->new_state.width = data->new_state.width;
+  last->new_state.height = data->new_state.height;
+  
+  return TRUE;
+}
+
+static void
+glide_undo_manager_end_actor_action_real (GlideUndoManager *manager,
+					  GlideActor *a,
+					  gboolean coalesce)
 {
   GlideUndoInfo *info;
   GlideUndoActorData *data;
-  JsonNode *new_node;
+  GlideUndoActorState *old_state, *new_state;
+  gint64 now;
   
   if (manager->priv->recorded_actor != (ClutterActor *)a)
     {
@@ -182,23 +432,127 @@ glide_undo_manager_end_actor_action (GlideUndoManager *manager,
       return;
     }
   
-  new_node = glide_actor_serialize (a);
+  old_state = manager->priv->recorded_state;
+  new_state = glide_undo_actor_state_new ((ClutterActor *)a);
 
+  data = g_malloc0 (sizeof (GlideUndoActorData));
+  
+  if (old_state->x != new_state->x || old_state->y != new_state->y ||
+      old_state->width != new_state->width || old_state->height != new_state->height)
+    data->changed |= GLIDE_UNDO_ACTOR_GEOMETRY;
+  if (GLIDE_IS_TEXT (a))
+    {
+      if (g_strcmp0 (old_state->text, new_state->text))
+	{
+	  guint known = GPOINTER_TO_UINT (g_object_get_data (G_OBJECT (a), TEXT_HASH_KEY));
+	  
+	  data->changed |= GLIDE_UNDO_ACTOR_TEXT;
+	  
+	  // Changed since its last record, so older diffs may not apply.
+	  if (known && known != glide_undo_text_hash (old_state->text))
+	    {
+	      data->full_text = TRUE;
+	      data->old_text = g_strdup (old_state->text ? old_state->text : "");
+	      data->new_text = g_strdup (new_state->text ? new_state->text : "");
+	    }
+	  else
+	    glide_undo_actor_data_diff_text (data, old_state->text ? old_state->text : "",
+					     new_state->text ? new_state->text : "");
+	  glide_undo_text_remember ((ClutterActor *)a, new_state->text);
+	}
+      if (g_strcmp0 (old_state->font_name, new_state->font_name))
+	data->changed |= GLIDE_UNDO_ACTOR_FONT;
+      if (!clutter_color_equal (&old_state->color, &new_state->color))
+	data->changed |= GLIDE_UNDO_ACTOR_COLOR;
+      if (old_state->alignment != new_state->alignment)
+	data->changed |= GLIDE_UNDO_ACTOR_ALIGNMENT;
+    }
+  
+  if (data->changed)
+    glide_undo_manager_actor_changed ((ClutterActor *)a);
+  
+  // The record owns the font names, the text only lives on in the diff.
+  data->old_state = *old_state;
+  data->new_state = *new_state;
+  data->old_state.text = data->new_state.text = NULL;
+  
+  g_free (old_state->text);
+  g_free (new_state->text);
+  g_slice_free (GlideUndoActorState, old_state);
+  g_slice_free (GlideUndoActorState, new_state);
+  manager->priv->recorded_state = NULL;
+  manager->priv->recorded_actor = NULL;
+  
+  // Monotonic, so stepping the clock back can't merge unrelated nudges.
+  now = g_get_monotonic_time ();
+  
+  if (!data->changed ||
+      (coalesce && glide_undo_manager_coalesce (manager, a, data, manager->priv->recorded_label, now)))
+    {
+      gboolean merged = data->changed != 0;
+      
+      GLIDE_NOTE (MISC, "Dropping or merging undo record: %s", manager->priv->recorded_label);
+      
+      g_free (data->old_state.font_name);
+      g_free (data->new_state.font_name);
+      g_free (data);
+      
+      g_free (manager->priv->recorded_label);
+      manager->priv->recorded_label = NULL;
+      
+      // The merged entry changed, so tell the journal.
+      if (merged)
+	{
+	  manager->priv->coalesce_time = now;
+	  g_signal_emit (manager, undo_manager_signals[OPERATION], 0,
+			 GLIDE_UNDO_OPERATION_APPLY, manager->priv->coalesce_info->label);
+	}
+      
+      return;
+    }
+  
   info = g_malloc (sizeof (GlideUndoInfo));
-  data = g_malloc (sizeof (GlideUndoActorData));
   
   info->undo_callback = glide_undo_actor_action_undo_callback;
   info->redo_callback = glide_undo_actor_action_redo_callback;
   info->free_callback = glide_undo_actor_info_free_callback;
   info->label = manager->priv->recorded_label;
   info->user_data = data;
-
+  info->size = sizeof (GlideUndoInfo) + sizeof (GlideUndoActorData) + strlen (info->label) +
+    (data->old_text ? strlen (data->old_text) : 0) + (data->new_text ? strlen (data->new_text) : 0) +
+    (data->old_state.font_name ? strlen (data->old_state.font_name) : 0) +
+    (data->new_state.font_name ? strlen (data->new_state.font_name) : 0);
+  
+  manager->priv->recorded_label = NULL;
   
   data->actor = (ClutterActor *)g_object_ref (G_OBJECT (a));
-  data->old_state = manager->priv->recorded_state;
-  data->new_state = json_node_get_object (new_node);
   
   glide_undo_manager_append_info (manager, info);
+  
+  if (coalesce)
+    {
+      manager->priv->coalesce_info = info;
+      manager->priv->coalesce_time = now;
+    }
+}
+
+void
+glide_undo_manager_end_actor_action (GlideUndoManager *manager,
+				     GlideActor *a)
+{
+  glide_undo_manager_end_actor_action_real (manager, a, FALSE);
+}
+
+/*
+ * Like glide_undo_manager_end_actor_action, but a move of the same actor
+ * shortly after the last one is merged into its entry. Used for
+ * keyboard nudges.
+ */
+void
+glide_undo_manager_end_coalesced_actor_action (GlideUndoManager *manager,
+					       GlideActor *a)
+{
+  glide_undo_manager_end_actor_action_real (manager, a, TRUE);
 }
 
 void
@@ -224,6 +578,8 @@ glide_undo_manager_append_delete (GlideUndoManager *manager,
   info->redo_callback = glide_undo_delete_actor_redo_callback;
   info->label = g_strdup("Delete object");
   info->user_data = data;
+  info->size = sizeof (GlideUndoInfo) + sizeof (GlideUndoDeleteActorData) +
+    glide_undo_estimate_actor_size (CLUTTER_ACTOR (a));
   
   data->actor = (ClutterActor *)g_object_ref (a);
   data->parent = g_object_ref (parent);
@@ -254,6 +610,8 @@ glide_undo_manager_append_insert (GlideUndoManager *manager,
   info->undo_callback = glide_undo_delete_actor_redo_callback;
   info->label = g_strdup("Insert object");
   info->user_data = data;
+  info->size = sizeof (GlideUndoInfo) + sizeof (GlideUndoDeleteActorData) +
+    glide_undo_estimate_actor_size (CLUTTER_ACTOR (a));
   
   data->actor = (ClutterActor *)g_object_ref (a);
   data->parent = g_object_ref (parent);
@@ -267,6 +625,57 @@ glide_undo_manager_init (GlideUndoManager *manager)
   manager->priv = GLIDE_UNDO_MANAGER_GET_PRIVATE (manager);
   
   manager->priv->infos = g_list_append (manager->priv->infos, NULL);
+  manager->priv->position = manager->priv->infos;
+  
+  manager->priv->max_entries = DEFAULT_MAX_ENTRIES;
+  manager->priv->max_bytes = DEFAULT_MAX_BYTES;
+}
+
+static void
+glide_undo_manager_get_property (GObject *object,
+				 guint prop_id,
+				 GValue *value,
+				 GParamSpec *pspec)
+{
+  GlideUndoManager *manager = GLIDE_UNDO_MANAGER (object);
+  
+  switch (prop_id)
+    {
+    case PROP_MAX_ENTRIES:
+      g_value_set_uint (value, manager->priv->max_entries);
+      break;
+    case PROP_MAX_BYTES:
+      g_value_set_ulong (value, manager->priv->max_bytes);
+      break;
+    case PROP_HISTORY_SIZE:
+      g_value_set_ulong (value, manager->priv->history_size);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+    }
+}
+
+static void
+glide_undo_manager_set_property (GObject *object,
+				 guint prop_id,
+				 const GValue *value,
+				 GParamSpec *pspec)
+{
+  GlideUndoManager *manager = GLIDE_UNDO_MANAGER (object);
+  
+  switch (prop_id)
+    {
+    case PROP_MAX_ENTRIES:
+      glide_undo_manager_set_max_entries (manager, g_value_get_uint (value));
+      break;
+    case PROP_MAX_BYTES:
+      glide_undo_manager_set_max_bytes (manager, g_value_get_ulong (value));
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+    }
 }
 
 static void
@@ -274,6 +683,8 @@ glide_undo_manager_finalize (GObject *object)
 {
   GlideUndoManager *manager = GLIDE_UNDO_MANAGER (object);
   GList *t = manager->priv->infos;
+  
+  glide_undo_manager_cancel_actor_action (manager);
   while (t)
     t = glide_undo_manager_free_undo_info (t);
   g_list_free (manager->priv->infos);
@@ -285,6 +696,38 @@ glide_undo_manager_class_init (GlideUndoManagerClass *klass)
   GObjectClass *object_class = G_OBJECT_CLASS (klass);
   
   object_class->finalize = glide_undo_manager_finalize;
+  object_class->get_property = glide_undo_manager_get_property;
+  object_class->set_property = glide_undo_manager_set_property;
+  
+  g_object_class_install_property (object_class,
+				   PROP_MAX_ENTRIES,
+				   g_param_spec_uint ("max-entries",
+						      "Maximum entries",
+						      "The number of entries kept in the history, 0 for no limit",
+						      0, G_MAXUINT,
+						      DEFAULT_MAX_ENTRIES,
+						      G_PARAM_READWRITE |
+						      G_PARAM_STATIC_STRINGS));
+  
+  g_object_class_install_property (object_class,
+				   PROP_MAX_BYTES,
+				   g_param_spec_ulong ("max-bytes",
+						       "Maximum bytes",
+						       "The estimated memory the history may hold, 0 for no limit",
+						       0, G_MAXULONG,
+						       DEFAULT_MAX_BYTES,
+						       G_PARAM_READWRITE |
+						       G_PARAM_STATIC_STRINGS));
+  
+  g_object_class_install_property (object_class,
+				   PROP_HISTORY_SIZE,
+				   g_param_spec_ulong ("history-size",
+						       "History size",
+						       "The estimated memory held by the history, in bytes",
+						       0, G_MAXULONG,
+						       0,
+						       G_PARAM_READABLE |
+						       G_PARAM_STATIC_STRINGS));
   
   undo_manager_signals[POSITION_CHANGED] = 
     g_signal_new ("position-changed",
@@ -295,6 +738,17 @@ glide_undo_manager_class_init (GlideUndoManagerClass *klass)
 		  gi_cclosure_marshal_generic,
 		  G_TYPE_NONE, 0, NULL);
   
+  /* Emitted once an entry has been applied, undone or redone, or a change merged into the last */
+  undo_manager_signals[OPERATION] = 
+    g_signal_new ("operation",
+		  G_TYPE_FROM_CLASS (object_class),
+		  G_SIGNAL_RUN_LAST,
+		  0,
+		  NULL, NULL,
+		  gi_cclosure_marshal_generic,
+		  G_TYPE_NONE, 2,
+		  G_TYPE_INT, G_TYPE_STRING);
+  
   g_type_class_add_private (object_class, sizeof(GlideUndoManagerPrivate));
 }
 
@@ -305,12 +759,70 @@ glide_undo_manager_new ()
 		       NULL);
 }
 
+static void
+glide_undo_manager_forget_info (GlideUndoManager *manager, GList *link)
+{
+  GlideUndoInfo *info = (GlideUndoInfo *)link->data;
+  
+  if (!info)
+    return;
+  
+  if (info == manager->priv->coalesce_info)
+    manager->priv->coalesce_info = NULL;
+  
+  manager->priv->n_entries--;
+  manager->priv->history_size -= info->size;
+  
+  glide_undo_manager_free_undo_info (link);
+}
+
+/*
+ * Drops the oldest entries which can be undone, then the redo entries
+ * furthest from the current position. The entry at the position itself
+ * is never dropped.
+ */
+static void
+glide_undo_manager_trim (GlideUndoManager *manager)
+{
+  GlideUndoManagerPrivate *priv = manager->priv;
+  gboolean trimmed = FALSE;
+  
+  while ((priv->max_entries && priv->n_entries > priv->max_entries) ||
+	 (priv->max_bytes && priv->history_size > priv->max_bytes))
+    {
+      GList *victim = priv->infos->next;
+      
+      // With everything undone the position is the placeholder at the
+      // head, and what follows it are redo entries.
+      if (!victim || victim == priv->position || priv->position == priv->infos)
+	{
+	  victim = g_list_last (priv->infos);
+	  if (victim == priv->position)
+	    break;
+	}
+      
+      GLIDE_NOTE (MISC, "Evicting undo entry: %s",
+		  ((GlideUndoInfo *)victim->data)->label);
+      
+      glide_undo_manager_forget_info (manager, victim);
+      priv->infos = g_list_delete_link (priv->infos, victim);
+      
+      trimmed = TRUE;
+    }
+  
+  if (trimmed)
+    g_object_notify (G_OBJECT (manager), "history-size");
+}
+
 void
 glide_undo_manager_append_info (GlideUndoManager *manager, GlideUndoInfo *info)
 {
   GList *t = g_list_next (manager->priv->position);
   while (t)
-    t = glide_undo_manager_free_undo_info (t);
+    {
+      glide_undo_manager_forget_info (manager, t);
+      t = t->next;
+    }
   if (manager->priv->position)
     {
       g_list_free (g_list_next (manager->priv->position));
@@ -325,6 +837,16 @@ glide_undo_manager_append_info (GlideUndoManager *manager, GlideUndoInfo *info)
   manager->priv->infos = g_list_append (manager->priv->infos, info);
   manager->priv->position = g_list_last (manager->priv->infos);
   
+  manager->priv->coalesce_info = NULL;
+  manager->priv->n_entries++;
+  manager->priv->history_size += info->size;
+  
+  g_signal_emit (manager, undo_manager_signals[OPERATION], 0,
+		 GLIDE_UNDO_OPERATION_APPLY, info->label);
+  
+  glide_undo_manager_trim (manager);
+  
+  g_object_notify (G_OBJECT (manager), "history-size");
   g_signal_emit (manager, undo_manager_signals[POSITION_CHANGED], 0);
 }
 
@@ -333,6 +855,7 @@ gboolean
 glide_undo_manager_redo (GlideUndoManager *manager)
 {
   GlideUndoInfo *info;
+  gboolean ret;
   
   if (!manager->priv->position->next)
     return FALSE;
@@ -340,15 +863,21 @@ glide_undo_manager_redo (GlideUndoManager *manager)
     info = (GlideUndoInfo *)manager->priv->position->next->data;
   
   manager->priv->position = manager->priv->position->next;
+  manager->priv->coalesce_info = NULL;
   g_signal_emit (manager, undo_manager_signals[POSITION_CHANGED], 0);  
 
-  return info->redo_callback (manager, info);
+  ret = info->redo_callback (manager, info);
+  g_signal_emit (manager, undo_manager_signals[OPERATION], 0,
+		 GLIDE_UNDO_OPERATION_REDO, info->label);
+  
+  return ret;
 }
 
 gboolean
 glide_undo_manager_undo (GlideUndoManager *manager)
 {
   GlideUndoInfo *info;
+  gboolean ret;
 
   if (!manager->priv->position->data)
     return FALSE;
@@ -356,9 +885,14 @@ glide_undo_manager_undo (GlideUndoManager *manager)
     info = (GlideUndoInfo *)manager->priv->position->data;
   
   manager->priv->position = manager->priv->position->prev;
+  manager->priv->coalesce_info = NULL;
   g_signal_emit (manager, undo_manager_signals[POSITION_CHANGED], 0);  
   
-  return info->undo_callback (manager, info);
+  ret = info->undo_callback (manager, info);
+  g_signal_emit (manager, undo_manager_signals[OPERATION], 0,
+		 GLIDE_UNDO_OPERATION_UNDO, info->label);
+  
+  return ret;
 }
 
 gboolean 
@@ -387,3 +921,39 @@ glide_undo_manager_get_redo_label (GlideUndoManager *manager)
   return info->label;
 }
 
+
+void
+glide_undo_manager_set_max_entries (GlideUndoManager *manager, guint max_entries)
+{
+  manager->priv->max_entries = max_entries;
+  glide_undo_manager_trim (manager);
+  
+  g_object_notify (G_OBJECT (manager), "max-entries");
+}
+
+guint
+glide_undo_manager_get_max_entries (GlideUndoManager *manager)
+{
+  return manager->priv->max_entries;
+}
+
+void
+glide_undo_manager_set_max_bytes (GlideUndoManager *manager, gulong max_bytes)
+{
+  manager->priv->max_bytes = max_bytes;
+  glide_undo_manager_trim (manager);
+  
+  g_object_notify (G_OBJECT (manager), "max-bytes");
+}
+
+gulong
+glide_undo_manager_get_max_bytes (GlideUndoManager *manager)
+{
+  return manager->priv->max_bytes;
+}
+
+gulong
+glide_undo_manager_get_history_size (GlideUndoManager *manager)
+{
+  return manager->priv->history_size;
+}
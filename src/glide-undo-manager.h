@@ -63,6 +63,12 @@ struct _GlideUndoManagerClass
   GObjectClass parent_class;
 };
 
+typedef enum {
+  GLIDE_UNDO_OPERATION_APPLY,
+  GLIDE_UNDO_OPERATION_UNDO,
+  GLIDE_UNDO_OPERATION_REDO
+} GlideUndoOperation;
+
 typedef struct _GlideUndoInfo GlideUndoInfo;
 typedef gboolean (*GlideUndoActionCallback) (GlideUndoManager *undo_manager, GlideUndoInfo *info);
 typedef void (*GlideUndoInfoFreeCallback) (GlideUndoInfo *info);
@@ -76,6 +82,9 @@ struct _GlideUndoInfo {
   gchar *label;
 
   gpointer user_data;
+  
+  /* Estimated memory held by the entry, in bytes */
+  gsize size;
 };
 
 /*
@@ -90,6 +99,7 @@ gboolean glide_undo_manager_redo (GlideUndoManager *manager);
 
 void glide_undo_manager_start_actor_action (GlideUndoManager *manager, GlideActor *a, const gchar *label);
 void glide_undo_manager_end_actor_action (GlideUndoManager *manager, GlideActor *a);
+void glide_undo_manager_end_coalesced_actor_action (GlideUndoManager *manager, GlideActor *a);
 
 void glide_undo_manager_append_delete (GlideUndoManager *manager, GlideActor *a);
 void glide_undo_manager_append_insert (GlideUndoManager *manager, GlideActor *a);
@@ -102,6 +112,14 @@ gboolean glide_undo_manager_get_can_redo (GlideUndoManager *manager);
 const gchar *glide_undo_manager_get_undo_label (GlideUndoManager *manager);
 const gchar *glide_undo_manager_get_redo_label (GlideUndoManager *manager);
 
+void glide_undo_manager_set_max_entries (GlideUndoManager *manager, guint max_entries);
+guint glide_undo_manager_get_max_entries (GlideUndoManager *manager);
+
+void glide_undo_manager_set_max_bytes (GlideUndoManager *manager, gulong max_bytes);
+gulong glide_undo_manager_get_max_bytes (GlideUndoManager *manager);
+
+gulong glide_undo_manager_get_history_size (GlideUndoManager *manager);
+
 G_END_DECLS
 
 #endif
@@ -26,6 +26,7 @@
 #include "glide-window.h"
 #include "glide-stage-manager.h"
 #include "glide-document.h"
+#include "glide-journal.h"
 
 G_BEGIN_DECLS
 
@@ -34,6 +35,7 @@ struct _GlideWindowPrivate
   GtkBuilder *builder;
   
   GtkWidget *embed;
+  GtkWidget *slide_sorter;
   ClutterActor *stage;
   
   GlideStageManager *manager;
@@ -47,6 +49,13 @@ struct _GlideWindowPrivate
   
   GtkRecentManager *recent_manager;
   GlideUndoManager *undo_manager;
+  
+  gboolean pretty_save;
+  guint saving;
+  gboolean quit_after_save;
+  
+  GlideJournal *journal;
+  guint journal_generation;
 };
 
 G_END_DECLS
@@ -25,6 +25,9 @@
 #include <gdk/gdkkeysyms.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
 
+#include <glib/gstdio.h>
+#include <string.h>
+
 #include <cairo.h>
 #include <cairo-pdf.h>
 
@@ -40,6 +43,8 @@
 #include "glide-gtk-util.h"
 
 #include "glide-slide.h"
+#include "glide-export.h"
+#include "glide-slide-sorter.h"
 
 #include "glide-debug.h"
 
@@ -67,6 +72,7 @@ static void glide_window_insert_stage (GlideWindow *w);
 static void glide_window_close_document (GlideWindow *w);
 
 static void glide_window_save_document_real (GlideWindow *w, const gchar *filename);
+static void glide_window_quit (GlideWindow *w);
 
 static void glide_window_save_and_quit_response_callback (GtkDialog *dialog, int response, gpointer user_data);
 
@@ -217,6 +223,28 @@ glide_window_slide_changed_cb (GObject *object,
     }
 }
 
+/*
+ * For edits which don't go through the undo manager, the slide sorter
+ * and journal hear about the rest from the slide and undo manager.
+ */
+static void
+glide_window_slide_edited (GlideWindow *w, GlideSlide *s)
+{
+  glide_slide_mark_dirty (s);
+  if (w->priv->journal)
+    glide_journal_slide_edited (w->priv->journal, s);
+}
+
+static void
+glide_window_current_slide_edited (GlideWindow *w)
+{
+  GlideSlide *s = glide_document_get_nth_slide (w->priv->document,
+						glide_stage_manager_get_current_slide (w->priv->manager));
+  
+  if (s)
+    glide_window_slide_edited (w, s);
+}
+
 void
 glide_window_color_set_cb (GtkWidget *b,
 			   gpointer user_data)
@@ -236,12 +264,14 @@ glide_window_color_set_cb (GtkWidget *b,
       GlideSlide *s = glide_document_get_nth_slide (w->priv->document,
 						    glide_stage_manager_get_current_slide (w->priv->manager));
       glide_slide_set_color (s, &cc);
+      glide_window_current_slide_edited (w);
     }
     
   if (!GLIDE_IS_TEXT (selection))
     return;
   
   glide_text_set_color (GLIDE_TEXT (selection), &cc);  
+  glide_window_current_slide_edited (w);
 }
 
 void
@@ -351,7 +381,9 @@ glide_window_update_title (GlideWindow *w)
   if (!path)
     path = "New Document";
   
-  if (glide_document_get_dirty (w->priv->document))
+  if (w->priv->saving)
+    title = g_strdup_printf ("Glide - (%s) - Saving...", path);
+  else if (glide_document_get_dirty (w->priv->document))
     title = g_strdup_printf ("Glide - (%s)*", path);
   else
     title = g_strdup_printf ("Glide - (%s)", path);
@@ -359,6 +391,50 @@ glide_window_update_title (GlideWindow *w)
   gtk_window_set_title (GTK_WINDOW (w), title);
   g_free (title);
 }
+
+static void
+glide_window_stop_journal (GlideWindow *w)
+{
+  if (!w->priv->journal)
+    return;
+  
+  glide_journal_free (w->priv->journal, TRUE);
+  w->priv->journal = NULL;
+  w->priv->journal_generation++;
+}
+
+/*
+ * Journals the document to the journal of path. A journal already
+ * running is moved there along with its records, a new one keeps what
+ * is already there with keep.
+ */
+static void
+glide_window_start_journal (GlideWindow *w, const gchar *path, gboolean keep)
+{
+  GError *e = NULL;
+  
+  if (!path)
+    return;
+  if (w->priv->journal)
+    {
+      if (glide_journal_set_document_path (w->priv->journal, path, &e))
+	return;
+      g_warning ("Failed to move the journal: %s", e->message);
+      g_error_free (e);
+      e = NULL;
+      glide_window_stop_journal (w);
+    }
+  
+  w->priv->journal = glide_journal_new (w->priv->document, w->priv->undo_manager,
+					path, keep, &e);
+  w->priv->journal_generation++;
+  if (!w->priv->journal)
+    {
+      g_warning ("Failed to start the journal, changes won't be recoverable: %s", e->message);
+      g_error_free (e);
+    }
+}
+
 static void
 glide_window_document_path_changed_cb (GObject *object,
 				       GParamSpec *pspec,
@@ -370,6 +446,8 @@ glide_window_document_path_changed_cb (GObject *object,
   GtkRecentData rd = { 0, };
   
   glide_window_update_title (w);
+  // Opened, a save moves the journal before the path is set.
+  glide_window_start_journal (w, path, TRUE);
   
   rd.mime_type = "application-x/glide";
   rd.app_name = "Glide";
@@ -443,6 +521,8 @@ glide_window_set_document (GlideWindow *w, GlideDocument *d)
   w->priv->undo_manager = glide_undo_manager_new ();
   glide_stage_manager_set_undo_manager (w->priv->manager, w->priv->undo_manager);
   
+  glide_slide_sorter_set_stage_manager (GLIDE_SLIDE_SORTER (w->priv->slide_sorter), w->priv->manager);
+  
   g_signal_connect (w->priv->document,
 		    "slide-added",
 		    G_CALLBACK (glide_window_document_n_slides_changed),
@@ -482,6 +562,10 @@ glide_window_set_document (GlideWindow *w, GlideDocument *d)
 static void
 glide_window_close_document (GlideWindow *w)
 {
+  glide_window_stop_journal (w);
+  
+  glide_slide_sorter_set_stage_manager (GLIDE_SLIDE_SORTER (w->priv->slide_sorter), NULL);
+  
   if (w->priv->document)
     g_object_unref (w->priv->document);
   if (w->priv->manager)
@@ -492,18 +576,75 @@ glide_window_close_document (GlideWindow *w)
   clutter_group_remove_all (CLUTTER_GROUP (w->priv->stage));
 }
 
+static gboolean
+glide_window_show_recover_dialog (GlideWindow *w)
+{
+  GtkWidget *dialog, *label;
+  gint response;
+  
+  dialog = gtk_dialog_new_with_buttons (_("Glide"),
+					GTK_WINDOW (w),
+					GTK_DIALOG_MODAL,
+					"Discard", GTK_RESPONSE_CLOSE,
+					"Recover", GTK_RESPONSE_OK,
+					NULL);
+  gtk_dialog_set_default_response (GTK_DIALOG (dialog), GTK_RESPONSE_OK);
+  label = gtk_label_new (_("This document has unsaved changes from a session which didn't exit cleanly. Recover them?"));
+  gtk_label_set_line_wrap (GTK_LABEL (label), TRUE);
+  gtk_misc_set_padding (GTK_MISC (label), 20, 20);
+  gtk_box_pack_start (GTK_BOX (GTK_DIALOG (dialog)->vbox), label,
+		      TRUE, TRUE, 0);
+  gtk_widget_show (label);
+  
+  response = gtk_dialog_run (GTK_DIALOG (dialog));
+  gtk_widget_destroy (dialog);
+  
+  return response == GTK_RESPONSE_OK;
+}
+
+/*
+ * A journal is only left behind when Glide didn't get to close the
+ * document, so offer to replay it. The journal is kept until the next
+ * save in case we go down again.
+ */
+static void
+glide_window_recover_journal (GlideWindow *w, const gchar *filename)
+{
+  gchar *path = glide_journal_get_path (filename);
+  GError *e = NULL;
+  
+  if (!g_file_test (path, G_FILE_TEST_EXISTS))
+    {
+      g_free (path);
+      return;
+    }
+  
+  if (!glide_window_show_recover_dialog (w))
+    {
+      g_unlink (path);
+      g_free (path);
+      return;
+    }
+  g_free (path);
+  
+  if (glide_journal_replay (w->priv->document, filename, &e) < 0)
+    {
+      glide_gtk_util_show_error_dialog ("Failed to recover changes", e->message);
+      g_error_free (e);
+      return;
+    }
+  glide_document_set_dirty (w->priv->document, TRUE);
+}
+
 void
 glide_window_open_document (GlideWindow *window,
 			    const gchar *filename)
 {
-  JsonParser *p = json_parser_new ();
   GError *e = NULL;
-  JsonNode *root, *slide_n;
-  JsonArray *slide_array;
-  JsonObject *root_obj;
 
-  json_parser_load_from_file (p, filename, &e);
-  if (e)
+  glide_window_set_document (window, glide_document_new (NULL));
+
+  if (!glide_stage_manager_load_file (window->priv->manager, filename, &e))
     {
       gchar *sec = g_strdup_printf ("Failed to load the document: %s", filename);
       g_warning("Error loading file: %s", e->message);
@@ -512,23 +653,14 @@ glide_window_open_document (GlideWindow *window,
 					
       g_error_free (e);
       g_free (sec);
-      g_object_unref (G_OBJECT (p));
+      
+      glide_window_close_document (window);
+      glide_window_new_document_real (window);
       
       return;
     }
-  root = json_parser_get_root (p);
-  root_obj = json_node_get_object (root);
-
-  glide_window_set_document (window, glide_document_new (glide_json_object_get_string (root_obj, "name")));
+  glide_window_recover_journal (window, filename);
   glide_document_set_path (window->priv->document, filename);
-
-  
-  slide_n = json_object_get_member (root_obj, "slides");
-  slide_array = json_node_get_array (slide_n);
-  
-  glide_stage_manager_load_slides (window->priv->manager, slide_array);
-  
-  g_object_unref (p);
 }
 
 static void
@@ -619,6 +751,15 @@ glide_window_insert_stage (GlideWindow *w)
   g_signal_connect_after (fixed, "size-allocate", G_CALLBACK (glide_window_fixed_embed_size_allocate), w);
 }
 
+static void
+glide_window_insert_slide_sorter (GlideWindow *w)
+{
+  GtkWidget *scrolled = GTK_WIDGET (gtk_builder_get_object (w->priv->builder, "slide-sorter-scrolled"));
+  
+  w->priv->slide_sorter = glide_slide_sorter_new ();
+  gtk_container_add (GTK_CONTAINER (scrolled), w->priv->slide_sorter);
+}
+
 static void
 glide_window_stage_enter_notify (GtkWidget *widget,
 				 GdkEventCrossing *event,
@@ -693,6 +834,7 @@ glide_window_slide_background_cb (GtkDialog *dialog,
       gchar *filename = gtk_file_chooser_get_filename (GTK_FILE_CHOOSER (dialog));
       
       glide_stage_manager_set_slide_background (window->priv->manager, filename);
+      glide_window_current_slide_edited (window);
       
       g_free (filename);
     }
@@ -718,7 +860,15 @@ glide_window_animations_box_changed_cb (GtkWidget *cbox,
       gtk_tree_model_get(model, &iter, 0, &animation, -1);
     }
   
+  // Showing a slide selects its animation here as well.
+  if (!g_strcmp0 (animation, glide_slide_get_animation (s) ? glide_slide_get_animation (s) : "None"))
+    {
+      g_free (animation);
+      return;
+    }
+  
   glide_slide_set_animation (s, animation);
+  glide_window_slide_edited (w, s);
   g_free (animation);
 }
 
@@ -882,7 +1032,7 @@ glide_window_quit_action_activate (GtkAction *a,
 {
   GlideWindow *w = (GlideWindow *) user_data;
   if (glide_window_show_quit_dialog (w))
-    gtk_main_quit ();
+    glide_window_quit (w);
 }
 
 void
@@ -1021,6 +1171,7 @@ glide_window_fullscreen_stage (GlideWindow *w)
   gtk_widget_show (GTK_WIDGET (w));
   gtk_widget_show_all (fixed);
   gtk_widget_show (gtk_widget_get_parent (fixed));
+  gtk_widget_show (gtk_widget_get_parent (gtk_widget_get_parent (fixed)));
   
   glide_document_get_size (w->priv->document, &w->priv->old_document_width, &w->priv->old_document_height);
   glide_document_resize (w->priv->document, gdk_screen_get_height (screen) * 1.3333,
@@ -1133,6 +1284,7 @@ glide_window_add_slide_action_activate (GtkAction *a,
    
   glide_slide_get_color (oslide, &oc);
   glide_slide_set_color (slide, &oc);
+  glide_window_slide_edited (window, slide);
 }
 
 void
@@ -1172,26 +1324,87 @@ glide_window_new_action_activate (GtkAction *a,
 }
 
 static void
-glide_window_save_document_real (GlideWindow *w,
-				 const gchar *filename)
+glide_window_quit (GlideWindow *w)
+{
+  // Let saves in progress finish writing first.
+  if (w->priv->saving)
+    {
+      w->priv->quit_after_save = TRUE;
+      return;
+    }
+  
+  glide_window_stop_journal (w);
+  gtk_main_quit ();
+}
+
+typedef struct _GlideWindowSave {
+  GlideWindow *window;
+  
+  guint journal_generation;
+  guint checkpoint;
+} GlideWindowSave;
+
+static void
+glide_window_save_done_cb (GlideDocument *document,
+			   const gchar *filename,
+			   const GError *error,
+			   gpointer user_data)
 {
-  JsonNode *node;
-  JsonGenerator *gen;
+  GlideWindowSave *save = (GlideWindowSave *)user_data;
+  GlideWindow *w = save->window;
+  
+  // Saved under another name, the records since the save go with it.
+  if (!error && document == w->priv->document)
+    glide_window_start_journal (w, filename, FALSE);
+  
+  if (w->priv->journal && save->journal_generation == w->priv->journal_generation)
+    glide_journal_end_checkpoint (w->priv->journal, save->checkpoint, error == NULL);
+  g_slice_free (GlideWindowSave, save);
   
-  node = glide_document_serialize (w->priv->document);
+  w->priv->saving--;
   
-  gen = json_generator_new ();
-  g_object_set (gen, "pretty", TRUE, NULL);
+  if (error)
+    {
+      w->priv->quit_after_save = FALSE;
+      if (document == w->priv->document)
+	glide_document_set_dirty (document, TRUE);
+      
+      glide_gtk_util_show_error_dialog ("Failed to save document", error->message);
+    }
+  else if (document == w->priv->document)
+    {
+      glide_document_set_path (document, filename);
+    }
   
-  json_generator_set_root (gen, node);
+  if (!w->priv->saving && w->priv->quit_after_save)
+    {
+      glide_window_quit (w);
+      return;
+    }
   
-  // TODO: Error
-  json_generator_to_file (gen, filename, NULL);
+  if (document == w->priv->document)
+    glide_window_update_title (w);
+}
 
+static void
+glide_window_save_document_real (GlideWindow *w,
+				 const gchar *filename)
+{
+  GlideWindowSave *save = g_slice_new0 (GlideWindowSave);
+  
+  // The journal has to know what the snapshot covers before it is taken.
+  save->window = w;
+  save->journal_generation = w->priv->journal_generation;
+  if (w->priv->journal)
+    save->checkpoint = glide_journal_begin_checkpoint (w->priv->journal);
+  
+  w->priv->saving++;
+  glide_document_write_to_file_async (w->priv->document, filename, w->priv->pretty_save,
+				      glide_window_save_done_cb, save);
+  
+  // Anything edited from here on isn't in the snapshot being saved.
   glide_document_set_dirty (w->priv->document, FALSE);
-  glide_document_set_path (w->priv->document, filename);
   
-  // Maybe gets called twice?
   glide_window_update_title (w);
 }
 
@@ -1218,7 +1431,7 @@ glide_window_save_and_quit_response_callback (GtkDialog *dialog,
 {
   glide_window_save_as_response_callback (dialog, response, user_data);
   
-  gtk_main_quit ();
+  glide_window_quit ((GlideWindow *)user_data);
 }
 
 
@@ -1287,23 +1500,20 @@ glide_window_setup_combobox (GlideWindow *w)
   GtkListStore *store = gtk_list_store_new (1, G_TYPE_STRING);
   GtkCellRenderer *renderer;
   GtkTreeIter iter;
+  GList *animations, *a;
   
   gtk_list_store_append (store, &iter);
   gtk_list_store_set (store, &iter, 0, "None", -1);
-  gtk_list_store_append (store, &iter);
-  gtk_list_store_set (store, &iter, 0, "Fade", -1);
-  gtk_list_store_append (store, &iter);
-  gtk_list_store_set (store, &iter, 0, "Zoom", -1);
-  gtk_list_store_append (store, &iter);
-  gtk_list_store_set (store, &iter, 0, "Drop", -1);
-  gtk_list_store_append (store, &iter);
-  gtk_list_store_set (store, &iter, 0, "Pivot", -1);
-  gtk_list_store_append (store, &iter);
-  gtk_list_store_set (store, &iter, 0, "Slide", -1);
-  gtk_list_store_append (store, &iter);
-  gtk_list_store_set (store, &iter, 0, "Zoom Contents", -1);
-  gtk_list_store_append (store, &iter);
-  gtk_list_store_set (store, &iter, 0, "Doorway", -1);
+  
+  animations = glide_animations_list ();
+  for (a = animations; a; a = a->next)
+    {
+      GlideAnimationInfo *info = (GlideAnimationInfo *)a->data;
+      
+      gtk_list_store_append (store, &iter);
+      gtk_list_store_set (store, &iter, 0, info->name, -1);
+    }
+  g_list_free (animations);
   
   gtk_combo_box_set_model (c, GTK_TREE_MODEL (store));
   g_object_unref (store);
@@ -1381,9 +1591,10 @@ glide_window_load_ui (GlideWindow *w)
   gtk_widget_reparent (main_box, GTK_WIDGET (w));
 }
 
+/* Used when the GL driver can't render offscreen */
 static void
-glide_window_export_pdf_real (GlideWindow *w,
-			      const gchar *filename)
+glide_window_export_pdf_onscreen (GlideWindow *w,
+				  const gchar *filename)
 {
   cairo_surface_t *pdf_surface;
   cairo_t *cr;
@@ -1438,6 +1649,27 @@ glide_window_export_pdf_real (GlideWindow *w,
   glide_stage_manager_set_current_slide (w->priv->manager, o_slide);
 }
 
+static void
+glide_window_export_pdf_real (GlideWindow *w,
+			      const gchar *filename)
+{
+  GError *e = NULL;
+  
+  if (glide_export_pdf_vector (w->priv->document, filename, &e))
+    return;
+  
+  if (g_error_matches (e, GLIDE_EXPORT_ERROR, GLIDE_EXPORT_ERROR_UNSUPPORTED))
+    {
+      GLIDE_NOTE (WINDOW, "Offscreen export failed (%s), exporting on screen", e->message);
+      glide_window_export_pdf_onscreen (w, filename);
+    }
+  else
+    {
+      glide_gtk_util_show_error_dialog ("Failed to export PDF", e->message);
+    }
+  g_error_free (e);
+}
+
 static void
 glide_window_export_pdf_response_callback (GtkDialog *dialog,
 					  int response,
@@ -1469,7 +1701,7 @@ glide_window_delete_event_cb (GtkWidget *w,
 			      gpointer user_data)
 {
   if (glide_window_show_quit_dialog (GLIDE_WINDOW (w)))
-    gtk_main_quit ();
+    glide_window_quit (GLIDE_WINDOW (w));
   return TRUE;
 }
 
@@ -1547,9 +1779,11 @@ glide_window_init (GlideWindow *window)
   GtkClipboard *clipboard = gtk_clipboard_get (GDK_SELECTION_CLIPBOARD);
 
   window->priv = GLIDE_WINDOW_GET_PRIVATE (window);
+  window->priv->pretty_save = TRUE;
   
   glide_window_load_ui (window);
   glide_window_insert_stage (window);
+  glide_window_insert_slide_sorter (window);
   glide_window_insert_recent_menu_item (window);
   
   window->priv->recent_manager = gtk_recent_manager_get_for_screen (gtk_window_get_screen (GTK_WINDOW (window)));
@@ -1566,6 +1800,12 @@ glide_window_init (GlideWindow *window)
   //  g_signal_connect (window, "hide", G_CALLBACK (glide_window_hide), window);
 }
 
+void
+glide_window_set_pretty_save (GlideWindow *w, gboolean pretty)
+{
+  w->priv->pretty_save = pretty;
+}
+
 GlideWindow *
 glide_window_new ()
 {
@@ -76,6 +76,8 @@ GlideWindow     *glide_window_new                       (void);
 
 void glide_window_open_document (GlideWindow *w, const gchar *filename);
 
+void glide_window_set_pretty_save (GlideWindow *w, gboolean pretty);
+
 G_END_DECLS
 
 #endif  /* __GLIDE_WINDOW_H__  */
@@ -32,47 +32,19 @@
 #include <glib/gi18n.h>
 
 #include "glide-window.h"
+#include "glide-transition-stats.h"
+#include "glide-batch.h"
 #include "glide-debug.h"
 
-guint glide_debug_flags = 0;
-
-#ifdef GLIDE_ENABLE_DEBUG
-static const GDebugKey glide_debug_keys[] = {
-  {"misc", GLIDE_DEBUG_MISC},
-  {"image", GLIDE_DEBUG_IMAGE},
-  {"manipulator", GLIDE_DEBUG_MANIPULATOR},
-  {"stage-manager", GLIDE_DEBUG_STAGE_MANAGER},
-  {"window", GLIDE_DEBUG_WINDOW},
-  {"paint", GLIDE_DEBUG_PAINT},
-  {"text", GLIDE_DEBUG_TEXT},
-  {"document", GLIDE_DEBUG_DOCUMENT}
-};
-
-static gboolean
-glide_arg_debug_cb (const char *key, const char *value, gpointer user_data)
-{
-  glide_debug_flags |=
-	g_parse_debug_string (value, glide_debug_keys, G_N_ELEMENTS (glide_debug_keys));
-  return TRUE;
-}
-
-static gboolean
-glide_arg_no_debug_cb (const char *key, const char *value, gpointer user_data)
-{
-  glide_debug_flags &=
-	~g_parse_debug_string (value, glide_debug_keys, G_N_ELEMENTS (glide_debug_keys));
-  return TRUE;
-}
-#endif
+static gchar *transition_stats_file = NULL;
+static gboolean compact_json = FALSE;
 
 static GOptionEntry glide_args[] = {
-#ifdef GLIDE_ENABLE_DEBUG
-  {"glide-debug", 0, 0, G_OPTION_ARG_CALLBACK, glide_arg_debug_cb,
-   "Glide debugging messages to show. Comma seperated list of: all, misc, image, manipulator, stage-manager, window, text, document, or paint",
-   "FLAGS"},
-  {"glide-no-debug", 0, 0, G_OPTION_ARG_CALLBACK, glide_arg_no_debug_cb,
-   "Disable glide debugging", "FLAGS"},
-#endif
+  {"transition-stats", 0, 0, G_OPTION_ARG_FILENAME, &transition_stats_file,
+   "Record transition frame times and write them as JSON to FILE when a presentation ends",
+   "FILE"},
+  {"compact-json", 0, 0, G_OPTION_ARG_NONE, &compact_json,
+   "Save documents without indentation, in batch resaves as well", NULL},
   {NULL,},
 };
 
@@ -102,6 +74,8 @@ glide_parse_args (int *argc, char ***argv)
   
   glide_group = glide_get_option_group ();
   g_option_context_add_group (option_context, glide_group);
+  g_option_context_add_group (option_context, glide_debug_get_option_group ());
+  g_option_context_add_group (option_context, glide_batch_get_option_group ());
   
   if (!g_option_context_parse (option_context, argc, argv, &error))
 	{
@@ -123,20 +97,37 @@ main (int argc, char *argv[])
 {
   GlideWindow *window;
 
-  gtk_set_locale ();
-  gtk_init (&argc, &argv);
-  gtk_clutter_init (&argc, &argv);
-  
-  g_set_application_name ("Glide");
+  g_thread_init (NULL);
   
+  // Parsed before GTK, which batch mode never initializes.
   if (glide_parse_args (&argc, &argv) == FALSE)
 	{
 	  g_critical ("Failed to parse arguments");
 	  return 1;
 	}
   
+  if (glide_batch_get_enabled ())
+    {
+      if (clutter_init (&argc, &argv) != CLUTTER_INIT_SUCCESS)
+	{
+	  g_critical ("Failed to initialize Clutter");
+	  return 1;
+	}
+      return glide_batch_run (argc, argv, !compact_json);
+    }
+  
+  gtk_set_locale ();
+  gtk_init (&argc, &argv);
+  gtk_clutter_init (&argc, &argv);
+  
+  g_set_application_name ("Glide");
+  
+  if (transition_stats_file)
+    glide_transition_stats_set_output (transition_stats_file);
+  
   GLIDE_NOTE (MISC, "Starting Glide");
   window = glide_window_new ();
+  glide_window_set_pretty_save (window, !compact_json);
   if (argc >= 2)
     glide_window_open_document (GLIDE_WINDOW (window), argv[1]);
 